@@ -0,0 +1,454 @@
+/**
+ * dictionary.c
+ *
+ * This file represents the dictionary of a node that the name and email of records are encoded against.
+ * Fields are cut into tokens at spaces, dots, dashes, underscores and digits, and an email domain from its @ to
+ * the end is one token. A token is given a code the second time it is seen, the doorkeeper remembers tokens
+ * seen once so names that only occur once never take up room in the dictionary.
+ *
+ * An encoded field is a stream of literal bytes and codes. Bytes from 0xF6 up never occur in UTF-8 and mark
+ * the codes: 0xF8 to 0xFF and one more byte is one of the first 2048 codes, 0xF6 and two bytes any code and
+ * 0xF7 escapes the literal byte that follows it. A field whose stream would be longer than the field itself
+ * is not encoded, the caller stores it as it is and passes raw to dictionary_decode.
+ *
+ * Codes are never taken back, so strings stay where they are for the life of the node and reader threads
+ * decode without a lock. Encoding takes a lock since the write-ahead log replay inserts from several threads
+ *
+ */
+
+#include "dictionary.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BYTE_CODE_LONG 0xF6
+#define BYTE_ESCAPE 0xF7
+#define BYTE_CODE_SHORT 0xF8
+#define SHORT_CODES 2048
+
+static const uint8_t *strings[DICTIONARY_MAX_CODES];
+static long codes;
+
+static uint32_t *slots;
+static int slotCapacity;
+static uint32_t doorkeeper[DICTIONARY_DOORKEEPER];
+
+static uint8_t *chunk;
+static size_t chunkUsed;
+static size_t chunkBytes;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int token_code(const uint8_t *token, int length);
+static int find(const uint8_t *token, int length, uint32_t hash);
+static int intern(const uint8_t *token, int length, uint32_t hash);
+static void slots_grow(void);
+static uint32_t token_hash(const uint8_t *token, int length);
+static int is_separator(uint8_t c);
+static int put_literal(uint8_t *out, uint8_t c);
+static int put_code(uint8_t *out, int code);
+
+/**
+ * Encodes a name or email against the dictionary, tokens that are not in it yet may be added
+ *
+ * @param field
+ * @param length
+ * @param out at least DICTIONARY_FIELD_MAX bytes
+ * @return the length of the encoded field, or -1 if the encoding is longer than the field and it should be
+ *         stored as it is
+ */
+int dictionary_encode(const char *field, uint8_t length, uint8_t *out) {
+    const uint8_t *bytes = (const uint8_t*)field;
+    uint8_t stream[2 * DICTIONARY_FIELD_MAX];
+    int len = 0;
+
+    pthread_mutex_lock(&lock);
+
+    for(int i = 0; i < length;) {
+        int end = i;
+
+        if(bytes[i] == '@') {
+            end = length;
+        } else {
+            while(end < length && !is_separator(bytes[end])) {
+                end++;
+            }
+        }
+
+        if(end == i) {
+            len += put_literal(stream + len, bytes[i]);
+            i++;
+            continue;
+        }
+
+        int code = end - i >= DICTIONARY_MIN_TOKEN ? token_code(bytes + i, end - i) : -1;
+
+        if(code >= 0 && (code < SHORT_CODES ? 2 : 3) < end - i) {
+            len += put_code(stream + len, code);
+        } else {
+            for(int j = i; j < end; j++) {
+                len += put_literal(stream + len, bytes[j]);
+            }
+        }
+
+        i = end;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    //Only escaped bytes make a stream longer than its field, such fields do not compress
+    if(len > length) {
+        return -1;
+    }
+
+    memcpy(out, stream, len);
+
+    return len;
+}
+
+/**
+ * Decodes a field encoded by dictionary_encode
+ *
+ * @param encoded
+ * @param length
+ * @param raw set for a field dictionary_encode did not encode, it is copied as it is
+ * @param out at least DICTIONARY_FIELD_MAX bytes
+ * @return the length of the field
+ */
+int dictionary_decode(const uint8_t *encoded, uint8_t length, int raw, uint8_t *out) {
+    if(raw) {
+        memcpy(out, encoded, length);
+        return length;
+    }
+
+    int len = 0;
+
+    for(int i = 0; i < length; i++) {
+        uint8_t c = encoded[i];
+
+        if(c < BYTE_CODE_LONG) {
+            if(len < DICTIONARY_FIELD_MAX) {
+                out[len++] = c;
+            }
+            continue;
+        }
+
+        if(i + 1 >= length || (c == BYTE_CODE_LONG && i + 2 >= length)) {
+            break;
+        }
+
+        if(c == BYTE_ESCAPE) {
+            if(len < DICTIONARY_FIELD_MAX) {
+                out[len++] = encoded[i + 1];
+            }
+            i += 1;
+            continue;
+        }
+
+        int code;
+
+        if(c == BYTE_CODE_LONG) {
+            code = encoded[i + 1] | encoded[i + 2] << 8;
+            i += 2;
+        } else {
+            code = (c - BYTE_CODE_SHORT) << 8 | encoded[i + 1];
+            i += 1;
+        }
+
+        const uint8_t *string = __atomic_load_n(&strings[code], __ATOMIC_ACQUIRE);
+
+        if(!string) {
+            continue;
+        }
+
+        int stringLength = string[0] < DICTIONARY_FIELD_MAX - len ? string[0] : DICTIONARY_FIELD_MAX - len;
+        memcpy(out + len, string + 1, stringLength);
+        len += stringLength;
+    }
+
+    return len;
+}
+
+/**
+ * Returns the number of codes and the memory the dictionary uses
+ *
+ * @param stats
+ */
+void dictionary_get_stats(dictionary_stats *stats) {
+    pthread_mutex_lock(&lock);
+
+    stats->codes = codes;
+    stats->bytes = chunkBytes + slotCapacity * sizeof(*slots) + sizeof(doorkeeper) + codes * sizeof(*strings);
+
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Writes the dictionary to a file as the number of codes followed by the length and bytes of every string
+ *
+ * @param file
+ * @return the number of bytes written
+ */
+long dictionary_save(FILE *file) {
+    pthread_mutex_lock(&lock);
+
+    uint32_t count = (uint32_t)codes;
+    long len = sizeof(count);
+
+    fwrite(&count, sizeof(count), 1, file);
+
+    for(long i = 0; i < codes; i++) {
+        fwrite(strings[i], 1, 1 + strings[i][0], file);
+        len += 1 + strings[i][0];
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return len;
+}
+
+/**
+ * Loads a dictionary written by dictionary_save. The codes the node already has have to be the first codes
+ * of the saved dictionary, the rest are added with the same codes
+ *
+ * @param bytes
+ * @param size
+ * @return a status, -1 means the saved dictionary does not match the dictionary of the node and 0 means success
+ */
+int dictionary_load(const uint8_t *bytes, size_t size) {
+    uint32_t count;
+
+    if(size < sizeof(count)) {
+        return -1;
+    }
+
+    memcpy(&count, bytes, sizeof(count));
+
+    if(count > DICTIONARY_MAX_CODES) {
+        return -1;
+    }
+
+    size_t offset = sizeof(count);
+    int status = 0;
+
+    pthread_mutex_lock(&lock);
+
+    for(uint32_t i = 0; i < count && status == 0; i++) {
+        if(offset >= size || offset + 1 + bytes[offset] > size) {
+            status = -1;
+            break;
+        }
+
+        const uint8_t *string = bytes + offset;
+        offset += 1 + string[0];
+
+        if(i < codes) {
+            if(memcmp(strings[i], string, 1 + string[0]) != 0) {
+                status = -1;
+            }
+            continue;
+        }
+
+        intern(string + 1, string[0], token_hash(string + 1, string[0]));
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return status;
+}
+
+/**
+ * Returns the code of a token. A token without a code gets one if the doorkeeper has seen it before and
+ * there are codes left. Has to be called with the lock held
+ *
+ * @param token
+ * @param length
+ * @return the code or -1 if the token has no code
+ */
+static int token_code(const uint8_t *token, int length) {
+    uint32_t hash = token_hash(token, length);
+    int code = find(token, length, hash);
+
+    if(code >= 0) {
+        return code;
+    }
+
+    uint32_t *seen = &doorkeeper[hash & (DICTIONARY_DOORKEEPER - 1)];
+
+    if(*seen != (hash | 1)) {
+        *seen = hash | 1;
+        return -1;
+    }
+
+    if(codes >= DICTIONARY_MAX_CODES) {
+        return -1;
+    }
+
+    *seen = 0;
+
+    return intern(token, length, hash);
+}
+
+/**
+ * Finds the code of a token in the index
+ *
+ * @param token
+ * @param length
+ * @param hash
+ * @return the code or -1 if the token has no code
+ */
+static int find(const uint8_t *token, int length, uint32_t hash) {
+    if(slotCapacity == 0) {
+        return -1;
+    }
+
+    for(uint32_t i = hash & (slotCapacity - 1); slots[i] != 0; i = (i + 1) & (slotCapacity - 1)) {
+        const uint8_t *string = strings[slots[i] - 1];
+
+        if(string[0] == length && memcmp(string + 1, token, length) == 0) {
+            return (int)slots[i] - 1;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Gives a token the next code. The string is written before the code is published so readers that see
+ * the code always see the whole string
+ *
+ * @param token
+ * @param length
+ * @param hash
+ * @return the code
+ */
+static int intern(const uint8_t *token, int length, uint32_t hash) {
+    if(!chunk || chunkUsed + 1 + length > DICTIONARY_CHUNK) {
+        //Earlier chunks are still referenced by strings and live as long as the node
+        chunk = malloc(DICTIONARY_CHUNK);
+
+        if(!chunk) {
+            perror("dictionary chunk || malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        chunkUsed = 0;
+        chunkBytes += DICTIONARY_CHUNK;
+    }
+
+    uint8_t *string = chunk + chunkUsed;
+    string[0] = (uint8_t)length;
+    memcpy(string + 1, token, length);
+    chunkUsed += 1 + length;
+
+    if((codes + 1) * 2 > slotCapacity) {
+        slots_grow();
+    }
+
+    int code = (int)codes;
+    uint32_t i = hash & (slotCapacity - 1);
+
+    while(slots[i] != 0) {
+        i = (i + 1) & (slotCapacity - 1);
+    }
+
+    slots[i] = code + 1;
+
+    __atomic_store_n(&strings[code], string, __ATOMIC_RELEASE);
+    codes += 1;
+
+    return code;
+}
+
+/**
+ * Doubles the index of the dictionary
+ */
+static void slots_grow(void) {
+    int capacity = slotCapacity ? slotCapacity * 2 : 1024;
+    uint32_t *grown = calloc(capacity, sizeof(*grown));
+
+    if(!grown) {
+        perror("dictionary slots || calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for(long code = 0; code < codes; code++) {
+        const uint8_t *string = strings[code];
+        uint32_t i = token_hash(string + 1, string[0]) & (capacity - 1);
+
+        while(grown[i] != 0) {
+            i = (i + 1) & (capacity - 1);
+        }
+
+        grown[i] = code + 1;
+    }
+
+    free(slots);
+    slots = grown;
+    slotCapacity = capacity;
+}
+
+/**
+ * The FNV-1a hash of a token
+ *
+ * @param token
+ * @param length
+ * @return the hash
+ */
+static uint32_t token_hash(const uint8_t *token, int length) {
+    uint32_t hash = 2166136261u;
+
+    for(int i = 0; i < length; i++) {
+        hash = (hash ^ token[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * Returns whether a byte ends a token
+ *
+ * @param c
+ * @return 1 for a separator, 0 otherwise
+ */
+static int is_separator(uint8_t c) {
+    return c == ' ' || c == '.' || c == '-' || c == '_' || c == '@' || (c >= '0' && c <= '9');
+}
+
+/**
+ * Writes a literal byte to an encoded field
+ *
+ * @param out
+ * @param c
+ * @return the number of bytes written
+ */
+static int put_literal(uint8_t *out, uint8_t c) {
+    if(c < BYTE_CODE_LONG) {
+        out[0] = c;
+        return 1;
+    }
+
+    out[0] = BYTE_ESCAPE;
+    out[1] = c;
+    return 2;
+}
+
+/**
+ * Writes a code to an encoded field
+ *
+ * @param out
+ * @param code
+ * @return the number of bytes written
+ */
+static int put_code(uint8_t *out, int code) {
+    if(code < SHORT_CODES) {
+        out[0] = BYTE_CODE_SHORT + (code >> 8);
+        out[1] = code & 0xFF;
+        return 2;
+    }
+
+    out[0] = BYTE_CODE_LONG;
+    out[1] = code & 0xFF;
+    out[2] = code >> 8;
+    return 3;
+}
@@ -0,0 +1,41 @@
+/**
+ * dictionary.h
+ *
+ * This file represents the interface for the dictionary that compresses the name and email of table records
+ *
+ */
+
+#ifndef OU3_DICTIONARY_H
+#define OU3_DICTIONARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+//With RECORD_DICTIONARY set the name and email of every record are stored encoded against the dictionary
+//of the node, see dictionary_encode, and decoded into the entry whenever a record is read
+#ifndef RECORD_DICTIONARY
+#define RECORD_DICTIONARY 0
+#endif
+
+#define DICTIONARY_MAX_CODES 65536
+#define DICTIONARY_MIN_TOKEN 3
+#define DICTIONARY_DOORKEEPER 16384
+#define DICTIONARY_FIELD_MAX 255
+#define DICTIONARY_CHUNK 65536
+
+/**
+ * The size of the dictionary, bytes counts the strings, the index and the doorkeeper
+ */
+typedef struct {
+    long codes;
+    size_t bytes;
+} dictionary_stats;
+
+int dictionary_encode(const char *field, uint8_t length, uint8_t *out);
+int dictionary_decode(const uint8_t *encoded, uint8_t length, int raw, uint8_t *out);
+void dictionary_get_stats(dictionary_stats *stats);
+long dictionary_save(FILE *file);
+int dictionary_load(const uint8_t *bytes, size_t size);
+
+#endif //OU3_DICTIONARY_H
@@ -0,0 +1,194 @@
+/**
+ * epoch.c
+ *
+ * This file represents the epoch based reclamation. There is one writer thread, it retires memory it has
+ * unlinked and frees it once every reader that was running when it was retired has left. Readers announce
+ * the epoch they entered in their own slot, the writer only ever reads the slots. The list of retired memory
+ * has a lock since the write-ahead log replay fills buckets from several threads
+ *
+ */
+
+#include "epoch.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Memory waiting for the readers of its epoch to leave
+ */
+typedef struct {
+    void *pointer;
+    uint64_t epoch;
+} retired_pointer;
+
+static uint64_t globalEpoch = 1;
+static int readerUsed[EPOCH_MAX_READERS];
+static uint64_t readerEpochs[EPOCH_MAX_READERS];
+
+static retired_pointer *retired;
+static long retiredLength;
+static long retiredCapacity;
+static pthread_mutex_t retiredLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t oldest_reader_epoch(void);
+static void collect(void);
+
+/**
+ * Registers a reader thread
+ *
+ * @return the reader slot to pass to epoch_enter and epoch_exit
+ */
+int epoch_register(void) {
+    for(int i = 0; i < EPOCH_MAX_READERS; i++) {
+        int unused = 0;
+
+        if(__atomic_compare_exchange_n(&readerUsed[i], &unused, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return i;
+        }
+    }
+
+    fprintf(stderr, "epoch_register: more than %d readers\n", EPOCH_MAX_READERS);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Gives back the slot of a reader thread that is not inside a read
+ *
+ * @param reader
+ */
+void epoch_unregister(int reader) {
+    __atomic_store_n(&readerUsed[reader], 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Starts a read, memory retired from now on stays valid until the matching epoch_exit
+ *
+ * @param reader
+ */
+void epoch_enter(int reader) {
+    uint64_t epoch = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST);
+
+    __atomic_store_n(&readerEpochs[reader], epoch, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Ends a read
+ *
+ * @param reader
+ */
+void epoch_exit(int reader) {
+    __atomic_store_n(&readerEpochs[reader], 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Frees memory once no reader can see it anymore. The writer calls this after the memory has been
+ * unlinked from everything readers can reach
+ *
+ * @param pointer
+ */
+void epoch_retire(void *pointer) {
+    if(!pointer) {
+        return;
+    }
+
+    pthread_mutex_lock(&retiredLock);
+
+    if(retiredLength == retiredCapacity) {
+        retiredCapacity = retiredCapacity ? retiredCapacity * 2 : EPOCH_COLLECT_THRESHOLD;
+        retired = realloc(retired, retiredCapacity * sizeof(*retired));
+
+        if(!retired) {
+            perror("retired || realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    retired[retiredLength].pointer = pointer;
+    retired[retiredLength].epoch = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST);
+    retiredLength += 1;
+
+    if(retiredLength % EPOCH_COLLECT_THRESHOLD == 0) {
+        collect();
+    }
+
+    pthread_mutex_unlock(&retiredLock);
+}
+
+/**
+ * Starts a new epoch and frees the retired memory that no reader can see. A reader that entered
+ * before the memory was retired has an epoch at most that of the memory and keeps it alive
+ */
+void epoch_collect(void) {
+    pthread_mutex_lock(&retiredLock);
+    collect();
+    pthread_mutex_unlock(&retiredLock);
+}
+
+/**
+ * Waits until every reader that was inside a read when this was called has left, memory that readers
+ * could reach before can be freed directly after that
+ */
+void epoch_synchronize(void) {
+    uint64_t epoch = __atomic_add_fetch(&globalEpoch, 1, __ATOMIC_SEQ_CST);
+
+    for(int i = 0; i < EPOCH_MAX_READERS; i++) {
+        uint64_t readerEpoch;
+
+        while((readerEpoch = __atomic_load_n(&readerEpochs[i], __ATOMIC_SEQ_CST)) != 0 && readerEpoch < epoch) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Returns the number of retired allocations that are not freed yet
+ *
+ * @return the number of allocations
+ */
+long epoch_pending(void) {
+    pthread_mutex_lock(&retiredLock);
+    long pending = retiredLength;
+    pthread_mutex_unlock(&retiredLock);
+
+    return pending;
+}
+
+/**
+ * epoch_collect with the retired lock held
+ */
+static void collect(void) {
+    __atomic_add_fetch(&globalEpoch, 1, __ATOMIC_SEQ_CST);
+
+    uint64_t oldest = oldest_reader_epoch();
+    long kept = 0;
+
+    for(long i = 0; i < retiredLength; i++) {
+        if(retired[i].epoch < oldest) {
+            free(retired[i].pointer);
+        } else {
+            retired[kept++] = retired[i];
+        }
+    }
+
+    retiredLength = kept;
+}
+
+/**
+ * Returns the epoch of the oldest reader inside a read, or one past the current epoch without readers
+ *
+ * @return the epoch
+ */
+static uint64_t oldest_reader_epoch(void) {
+    uint64_t oldest = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST) + 1;
+
+    for(int i = 0; i < EPOCH_MAX_READERS; i++) {
+        uint64_t epoch = __atomic_load_n(&readerEpochs[i], __ATOMIC_SEQ_CST);
+
+        if(epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    return oldest;
+}
@@ -0,0 +1,26 @@
+/**
+ * epoch.h
+ *
+ * This file represents the interface for the epoch based reclamation that lets reader threads use
+ * memory the writer has replaced until none of them can still see it
+ *
+ */
+
+#ifndef OU3_EPOCH_H
+#define OU3_EPOCH_H
+
+#include <stdint.h>
+
+#define EPOCH_MAX_READERS 64
+#define EPOCH_COLLECT_THRESHOLD 64
+
+int epoch_register(void);
+void epoch_unregister(int reader);
+void epoch_enter(int reader);
+void epoch_exit(int reader);
+void epoch_retire(void *pointer);
+void epoch_collect(void);
+void epoch_synchronize(void);
+long epoch_pending(void);
+
+#endif //OU3_EPOCH_H
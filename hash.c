@@ -1,13 +1,131 @@
 #include "hash.h"
+#include <string.h>
 
-static hash_t digest(char* ssn, uint32_t len) {
-    uint32_t hash = 5381;
-    for(int i = 0; i < len; i++) {
-        hash = ((hash << 5) + hash) + (uint32_t)ssn[i];
+static uint64_t fmix64(uint64_t key);
+static uint64_t load_le(const char* bytes, int len);
+
+/**
+ * Returns the position of an ssn on the ring, the digest of HASH_FUNCTION truncated to HASH_BITS
+ */
+hash_t hash_ssn(char* ssn) {
+#if HASH_FUNCTION == HASH_MIX
+    return (hash_t) hash_ssn_mix(ssn);
+#else
+    return (hash_t) hash_ssn_djb2(ssn);
+#endif
+}
+
+/**
+ * Hashes count ssns like hash_ssn, one after the other. The callers hash whole batches up front so the
+ * digests are ready before the buckets are touched
+ */
+void hash_ssn_batch(char* const* ssns, int count, hash_t* hashes) {
+    for(int i = 0; i < count; i++) {
+        hashes[i] = hash_ssn(ssns[i]);
     }
-    return (hash_t) (hash % 256);
 }
 
-hash_t hash_ssn(char* ssn) {
-    return digest(ssn, 12);
+/**
+ * djb2 over the 12 ssn bytes in 64 bits. The low 8 bits are the same as the 32 bit digest modulo 256
+ * that the ring has always used
+ */
+uint64_t hash_ssn_djb2(const char* ssn) {
+    uint64_t hash = 5381;
+    for(int i = 0; i < 12; i++) {
+        hash = ((hash << 5) + hash) + (uint64_t)ssn[i];
+    }
+    return hash;
+}
+
+/**
+ * Multiplies the 12 ssn bytes, read as two little endian words, into one word and runs the murmur3
+ * finalizer over it so every input bit affects every output bit
+ */
+uint64_t hash_ssn_mix(const char* ssn) {
+    uint64_t hash = load_le(ssn, 8) * UINT64_C(0x87c37b91114253d5);
+    hash = ((hash << 31) | (hash >> 33)) ^ load_le(ssn + 8, 4);
+    hash *= UINT64_C(0x4cf5ad432745937f);
+    return fmix64(hash ^ 12);
+}
+
+/**
+ * Second level hash used to place a packed ssn key inside a bucket. It is the murmur3 finalizer so it
+ * is independent of the ssn digest that picks the bucket.
+ */
+uint32_t hash_key_probe(uint64_t key) {
+    return (uint32_t)fmix64(key);
+}
+
+/**
+ * Third level hash that picks the bloom filter bits of a packed ssn key. The key is offset before the
+ * finalizer so the bits are independent of hash_key_probe
+ */
+uint64_t hash_key_filter(uint64_t key) {
+    return fmix64(key ^ UINT64_C(0x9e3779b97f4a7c15));
+}
+
+/**
+ * Packs a 12 digit ssn into its integer value so keys compare and sort as numbers. An ssn with other
+ * characters gets SSN_KEY_RAW set and a 63 bit FNV-1a hash of its bytes, such keys are not unique
+ * and the raw ssn has to be compared as well.
+ */
+uint64_t ssn_pack(const char* ssn) {
+    uint64_t key = 0;
+
+    for(int i = 0; i < 12; i++) {
+        if(ssn[i] < '0' || ssn[i] > '9') {
+            uint64_t hash = UINT64_C(14695981039346656037);
+
+            for(int j = 0; j < 12; j++) {
+                hash ^= (uint8_t)ssn[j];
+                hash *= UINT64_C(1099511628211);
+            }
+            return hash | SSN_KEY_RAW;
+        }
+        key = key * 10 + (uint64_t)(ssn[i] - '0');
+    }
+
+    return key;
+}
+
+/**
+ * Writes the 12 digits of a packed ssn key, returns -1 for a raw key which can not be unpacked.
+ */
+int ssn_unpack(uint64_t key, char* ssn) {
+    if(key & SSN_KEY_RAW) {
+        return -1;
+    }
+
+    for(int i = 11; i >= 0; i--) {
+        ssn[i] = (char)('0' + key % 10);
+        key /= 10;
+    }
+
+    return 0;
+}
+
+/**
+ * The murmur3 64 bit finalizer
+ */
+static uint64_t fmix64(uint64_t key) {
+    key ^= key >> 33;
+    key *= UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    key *= UINT64_C(0xc4ceb9fe1a85ec53);
+    key ^= key >> 33;
+    return key;
+}
+
+/**
+ * Reads len bytes as a little endian number so the mix digest is the same on every host
+ */
+static uint64_t load_le(const char* bytes, int len) {
+    uint64_t value = 0;
+
+    memcpy(&value, bytes, len);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value) >> (64 - 8 * len);
+#endif
+
+    return value;
 }
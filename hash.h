@@ -1,3 +1,39 @@
 #include <inttypes.h>
+
+//The width of the keyspace, 8 is the 256 hash ring every node speaks. Wider builds only talk to nodes with the same width
+#ifndef HASH_BITS
+#define HASH_BITS 8
+#endif
+
+#if HASH_BITS == 8
 #define hash_t uint8_t
+#elif HASH_BITS == 16
+#define hash_t uint16_t
+#elif HASH_BITS == 32
+#define hash_t uint32_t
+#elif HASH_BITS == 64
+#define hash_t uint64_t
+#else
+#error "HASH_BITS has to be 8, 16, 32 or 64"
+#endif
+
+//The hash that places an ssn on the ring. djb2 is what every node speaks, mix spreads dates and serials evenly
+#define HASH_DJB2 1
+#define HASH_MIX 2
+
+#ifndef HASH_FUNCTION
+#define HASH_FUNCTION HASH_DJB2
+#endif
+
+#define HASH_MAX ((hash_t)~(hash_t)0)
+#define HASH_BUCKET_BITS 8
+#define HASH_BUCKET(hash) ((int)((uint64_t)(hash) >> (HASH_BITS - HASH_BUCKET_BITS)))
+#define SSN_KEY_RAW (UINT64_C(1) << 63)
 hash_t hash_ssn(char* ssn);
+void hash_ssn_batch(char* const* ssns, int count, hash_t* hashes);
+uint64_t hash_ssn_djb2(const char* ssn);
+uint64_t hash_ssn_mix(const char* ssn);
+uint32_t hash_key_probe(uint64_t key);
+uint64_t hash_key_filter(uint64_t key);
+uint64_t ssn_pack(const char* ssn);
+int ssn_unpack(uint64_t key, char* ssn);
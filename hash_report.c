@@ -0,0 +1,247 @@
+/**
+ * hash_report.c
+ *
+ * This file represents a tool that reports how evenly the ssn hash functions spread a sample of ssns over
+ * the buckets of a table and over the nodes of a ring. The sample file has one ssn per line.
+ *
+ * Usage: hash_report <sample file> [nodes]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "hash.h"
+#include "pdu.h"
+
+#define REPORT_BUCKETS (1 << HASH_BUCKET_BITS)
+#define REPORT_MAX_NODES 4096
+#define REPORT_ROUNDS 5
+
+/**
+ * A hash function that can be compared by the report
+ */
+typedef struct {
+    const char *name;
+    uint64_t (*digest)(const char *ssn);
+} report_function;
+
+static char *read_sample(const char *path, long *count);
+static void report(const report_function *function, const char *sample, long count, int nodes);
+static void print_spread(const char *title, const long *counts, int len);
+static void report_batch(const char *sample, long count);
+static double elapsed(const struct timespec *start);
+
+/**
+ * Prints the bucket and node spread of every hash function for a sample of ssns
+ *
+ * @param argc
+ * @param argv
+ * @return the exit status
+ */
+int main(int argc, char *argv[]) {
+    if(argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage: %s <sample file> [nodes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int nodes = argc == 3 ? atoi(argv[2]) : 16;
+
+    if(nodes < 1 || nodes > REPORT_MAX_NODES) {
+        fprintf(stderr, "nodes has to be between 1 and %d\n", REPORT_MAX_NODES);
+        return EXIT_FAILURE;
+    }
+
+    long count;
+    char *sample = read_sample(argv[1], &count);
+
+    if(!sample) {
+        return EXIT_FAILURE;
+    }
+
+    report_function functions[] = {
+            {"djb2", hash_ssn_djb2},
+            {"mix", hash_ssn_mix}
+    };
+
+    printf("%ld ssns, %d bit keyspace, %d buckets, %d nodes with equal ranges\n", count, HASH_BITS, REPORT_BUCKETS, nodes);
+
+    for(size_t i = 0; i < sizeof(functions) / sizeof(*functions); i++) {
+        report(&functions[i], sample, count, nodes);
+    }
+
+    report_batch(sample, count);
+
+    free(sample);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Reads the ssns of a sample file into one array of SSN_LENGTH byte ssns, lines shorter than an ssn are skipped
+ *
+ * @param path the sample file or - for stdin
+ * @param count set to the number of ssns
+ * @return the ssns or NULL if the file could not be read
+ */
+static char *read_sample(const char *path, long *count) {
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+
+    if(!file) {
+        perror("read_sample || fopen");
+        return NULL;
+    }
+
+    long capacity = 1024;
+    char *sample = malloc(capacity * SSN_LENGTH);
+    char line[256];
+
+    *count = 0;
+
+    while(fgets(line, sizeof(line), file)) {
+        if(strcspn(line, "\r\n") < SSN_LENGTH) {
+            continue;
+        }
+
+        if(*count == capacity) {
+            capacity *= 2;
+            sample = realloc(sample, capacity * SSN_LENGTH);
+
+            if(!sample) {
+                perror("sample || realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        memcpy(sample + *count * SSN_LENGTH, line, SSN_LENGTH);
+        *count += 1;
+    }
+
+    if(file != stdin) {
+        fclose(file);
+    }
+
+    return sample;
+}
+
+/**
+ * Hashes the sample with one function and prints its spread over buckets and nodes and its speed
+ *
+ * @param function
+ * @param sample
+ * @param count
+ * @param nodes
+ */
+static void report(const report_function *function, const char *sample, long count, int nodes) {
+    long buckets[REPORT_BUCKETS] = {0};
+    long ring[REPORT_MAX_NODES] = {0};
+
+    for(long i = 0; i < count; i++) {
+        hash_t hash = (hash_t) function->digest(sample + i * SSN_LENGTH);
+
+        buckets[HASH_BUCKET(hash)] += 1;
+        ring[(int)(((unsigned __int128)hash * nodes) >> HASH_BITS)] += 1;
+    }
+
+    //The fastest of a few rounds, a single round is too noisy on a busy machine
+    double best = 0;
+    volatile uint64_t sink = 0;
+
+    for(int round = 0; round < REPORT_ROUNDS; round++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for(long i = 0; i < count; i++) {
+            sink ^= function->digest(sample + i * SSN_LENGTH);
+        }
+
+        double seconds = elapsed(&start);
+        best = round == 0 || seconds < best ? seconds : best;
+    }
+
+    printf("\n%s: %.1f ns per ssn\n", function->name, count > 0 ? best * 1e9 / count : 0);
+    print_spread("buckets", buckets, REPORT_BUCKETS);
+    print_spread("nodes", ring, nodes);
+}
+
+/**
+ * Prints the speed of hash_ssn_batch, which hashes with the function the nodes are built with
+ *
+ * @param sample
+ * @param count
+ */
+static void report_batch(const char *sample, long count) {
+    char **ssns = malloc((count + 1) * sizeof(*ssns));
+    hash_t *hashes = malloc((count + 1) * sizeof(*hashes));
+
+    for(long i = 0; i < count; i++) {
+        ssns[i] = (char*)sample + i * SSN_LENGTH;
+    }
+
+    double best = 0;
+
+    for(int round = 0; round < REPORT_ROUNDS; round++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        hash_ssn_batch(ssns, (int)count, hashes);
+
+        double seconds = elapsed(&start);
+        best = round == 0 || seconds < best ? seconds : best;
+    }
+
+    printf("\nhash_ssn_batch (%s): %.1f ns per ssn\n", HASH_FUNCTION == HASH_MIX ? "mix" : "djb2", count > 0 ? best * 1e9 / count : 0);
+
+    free(ssns);
+    free(hashes);
+}
+
+/**
+ * Prints the spread of counts, the largest count relative to the mean is the skew a node sees
+ *
+ * @param title
+ * @param counts
+ * @param len
+ */
+static void print_spread(const char *title, const long *counts, int len) {
+    long min = counts[0];
+    long max = counts[0];
+    double sum = 0;
+
+    for(int i = 0; i < len; i++) {
+        min = counts[i] < min ? counts[i] : min;
+        max = counts[i] > max ? counts[i] : max;
+        sum += counts[i];
+    }
+
+    double mean = sum / len;
+    double variance = 0;
+    double chiSquare = 0;
+
+    for(int i = 0; i < len; i++) {
+        variance += (counts[i] - mean) * (counts[i] - mean);
+    }
+
+    if(mean > 0) {
+        chiSquare = variance / mean;
+    }
+    variance /= len;
+
+    printf("    %-8s min %-8ld max %-8ld mean %-10.1f stddev %-10.1f max/mean %-6.2f chi2/dof %.2f\n",
+           title, min, max, mean, sqrt(variance), mean > 0 ? max / mean : 0, len > 1 ? chiSquare / (len - 1) : 0);
+}
+
+/**
+ * Returns the seconds since start
+ *
+ * @param start
+ * @return the elapsed seconds
+ */
+static double elapsed(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
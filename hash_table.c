@@ -11,8 +11,111 @@
 
 #include "hash_table.h"
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-static int hash_table_lookup_index(bucket *b, const char *ssn);
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if HASH_CONCURRENT
+#include "epoch.h"
+#define RETIRE(pointer) epoch_retire(pointer)
+#else
+#define RETIRE(pointer) free(pointer)
+#endif
+
+#define BUCKET_MIN_CAPACITY 8
+#define TAG_EMPTY 0x80
+#define TAG_DELETED 0xFE
+#define TAG_IS_FULL(tag) ((tag) < 0x80)
+#define TAG_FINGERPRINT(probe) ((uint8_t)((probe) >> 25))
+#define COMPACT_RATIO 8
+#define FILTER_BITS_PER_SLOT 8
+#define FILTER_HASHES 3
+
+#define FILE_MAGIC 0x54325050
+#define FILE_VERSION 4
+#define FILE_GROUP_WIDTH 32
+#define FILE_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+/**
+ * Every slot has a one byte tag, TAG_EMPTY, TAG_DELETED or a 7 bit fingerprint of the probe hash. Probing compares a
+ * group of tags at once and only compares the ssn of slots whose fingerprint matches. The group width is
+ * picked when building: 32 with AVX2, 16 with SSE2 and a scalar loop over 8 tags otherwise
+ */
+#if defined(__AVX2__)
+#define GROUP_WIDTH 32
+#elif defined(__SSE2__)
+#define GROUP_WIDTH 16
+#else
+#define GROUP_WIDTH 8
+#endif
+
+static int hash_table_lookup_index(bucket *b, uint64_t key, const char *ssn);
+static void bucket_rehash(bucket *b, int capacity);
+static void bucket_release(bucket *b);
+static void bucket_remove_slot(bucket *b, int index);
+static void bucket_split(bucket *b, hash_t lo, hash_t hi, bucket *dest);
+static int bucket_find_free(bucket *b, uint32_t probe);
+static void bucket_set_tag(bucket *b, int index, uint8_t tag);
+static uint32_t group_match(const uint8_t *tags, uint8_t tag);
+static uint32_t group_match_free(const uint8_t *tags);
+static size_t record_size(const hash_table_slot *slot);
+static void record_to_entry(const hash_table_slot *slot, hash_table_entry *entry);
+static void hash_table_mapping_release(hash_table_mapping *mapping);
+static void bucket_filter_build(bucket *b);
+static void bucket_filter_add(bucket *b, uint64_t key);
+static int bucket_filter_contains(const bucket *b, uint64_t key);
+static uint64_t filter_mask(uint64_t hash);
+static hash_table *table_resize(hash_table *table, hash_t newMin, hash_t newMax);
+static int table_lookup(hash_table *table, const char *ssn, hash_table_entry *entry, int counted);
+static bucket *buckets_resize(bucket *buckets, int oldSpan, int newSpan);
+static void bucket_insert(bucket *b, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength);
+static void bucket_reserve(bucket *b, int incoming);
+static void bucket_prefetch(const bucket *b, uint64_t key);
+static void seq_write_begin(unsigned int *seq);
+static void seq_write_end(unsigned int *seq);
+#if HASH_CONCURRENT
+static unsigned int seq_read_begin(const unsigned int *seq);
+static int seq_read_retry(const unsigned int *seq, unsigned int start);
+static int lookup_changed(const hash_table *table, unsigned int tableSeq, const bucket *b, unsigned int bucketSeq);
+#endif
+
+/**
+ * The header of a table file. It is followed by one file_bucket per bucket in the range, then the slots
+ * and tags of every bucket and last the record heap. Record pointers in the slots are stored as offsets
+ * from the start of the file. Records are padded to their slab size so a removed record can be reused
+ * through the free lists of the bucket slab. With RECORD_DICTIONARY the dictionary the records are encoded
+ * against follows the record heap, see dictionary_save
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t minHash;
+    uint64_t maxHash;
+    uint8_t hashBits;
+    uint8_t hashFunction;
+    uint8_t recordWire;
+    uint8_t recordDictionary;
+    uint8_t padding[4];
+    uint64_t size;
+    uint64_t dictionary;
+} file_header;
+
+/**
+ * A bucket in the directory of a table file
+ */
+typedef struct {
+    uint32_t capacity;
+    uint32_t length;
+    uint64_t slots;
+    uint64_t tags;
+} file_bucket;
+
+static int file_valid(const uint8_t *base, const file_header *header, int span);
 
 /**
  *
@@ -24,83 +127,168 @@ static int hash_table_lookup_index(bucket *b, const char *ssn);
  * @param max
  * @return The hash table pointer
  */
-hash_table* hash_table_create(uint8_t min, uint8_t max){
+hash_table* hash_table_create(hash_t min, hash_t max){
     hash_table *table = calloc(1, sizeof(*table));
     table->minHash = min;
     table->maxHash = max;
-    table->buckets = calloc(max-min+1, sizeof(*table->buckets));
+    table->buckets = calloc(HASH_BUCKET(max) - HASH_BUCKET(min) + 1, sizeof(*table->buckets));
 
     if(!table->buckets) {
         perror("table->buckets || calloc");
     }
 
-    for (int i = 0; i < (max-min)+1; i++) {
-        table->buckets[i].length = 0;
-    }
+    return table;
+}
+
+/**
+ * Resizes the hash table in place. Buckets outside the new range are released and buckets in both
+ * ranges are moved to their new position, records are never copied. Entries outside the new range
+ * are dropped from a bucket that is cut by one of the new bounds
+ *
+ * @param table
+ * @param newMin
+ * @param newMax
+ * @return The hash table pointer
+ */
+hash_table* hash_table_resize(hash_table *table, hash_t newMin, hash_t newMax){
+    seq_write_begin(&table->seq);
+    table_resize(table, newMin, newMax);
+    seq_write_end(&table->seq);
 
     return table;
 }
 
 /**
- * Resizes the hash table by creating a new hash table and destroying the old one
+ * hash_table_resize without the sequence count of the table
  *
  * @param table
  * @param newMin
  * @param newMax
  * @return The hash table pointer
  */
-hash_table* hash_table_resize(hash_table *table, uint8_t newMin, uint8_t newMax){
-    hash_table *newTable = hash_table_create(newMin, newMax);
+static hash_table *table_resize(hash_table *table, hash_t newMin, hash_t newMax) {
+    int oldMin = HASH_BUCKET(table->minHash);
+    int oldMax = HASH_BUCKET(table->maxHash);
+    int oldSpan = hash_table_get_bucket_count(table);
+    int newSpanMin = HASH_BUCKET(newMin);
+    int newSpanMax = HASH_BUCKET(newMax);
+    int newSpan = newSpanMax - newSpanMin + 1;
 
-    int len = newMax - newMin;
+    for(int i = 0; i < oldSpan; i++) {
+        if(oldMin + i < newSpanMin || oldMin + i > newSpanMax) {
+            bucket_release(&table->buckets[i]);
+        }
+    }
 
-    for(int i = 0; i < len; i++){
-        if(newMin + i >= table->minHash && newMin + i <= table->maxHash){
-            int bucketLen = table->buckets[newMin + i - table->minHash].length;
+    int keepMin = oldMin > newSpanMin ? oldMin : newSpanMin;
+    int keepMax = oldMax < newSpanMax ? oldMax : newSpanMax;
+    int keepLen = keepMax >= keepMin ? keepMax - keepMin + 1 : 0;
 
-            newTable->buckets[i].list = calloc(bucketLen, sizeof(newTable->buckets[i].list));
+    if(newSpan > oldSpan) {
+        table->buckets = buckets_resize(table->buckets, oldSpan, newSpan);
+    }
 
-            if(!newTable->buckets[i].list) {
-                perror("newTable->buckets[i].list || calloc");
-            }
+    if(keepLen > 0) {
+        memmove(&table->buckets[keepMin - newSpanMin], &table->buckets[keepMin - oldMin], keepLen * sizeof(*table->buckets));
+        memset(table->buckets, 0, (keepMin - newSpanMin) * sizeof(*table->buckets));
+        memset(&table->buckets[keepMax - newSpanMin + 1], 0, (newSpanMax - keepMax) * sizeof(*table->buckets));
 
-            int oldIndexMapped = newMin + i - table->minHash;
-            for(int j = 0; j < bucketLen; j++){
+        if(table->minHash < newMin && newSpanMin >= oldMin && HASH_BUCKET(newMin - 1) == newSpanMin) {
+            bucket_split(&table->buckets[0], table->minHash, newMin - 1, NULL);
+        }
 
-                char* ssn = table->buckets[oldIndexMapped].list[j]->ssn;
-                char* name = table->buckets[oldIndexMapped].list[j]->name;
-                char* email = table->buckets[oldIndexMapped].list[j]->email;
-                newTable->buckets[i].list[j] = hash_table_create_entry(ssn, name, email);
-            }
-            newTable->buckets[i].length = table->buckets[oldIndexMapped].length;
+        if(table->maxHash > newMax && newSpanMax <= oldMax && HASH_BUCKET(newMax + 1) == newSpanMax) {
+            bucket_split(&table->buckets[newSpan - 1], newMax + 1, table->maxHash, NULL);
+        }
+    } else {
+        memset(table->buckets, 0, newSpan * sizeof(*table->buckets));
+    }
+
+    if(newSpan < oldSpan) {
+        table->buckets = buckets_resize(table->buckets, oldSpan, newSpan);
+    }
+
+    table->minHash = newMin;
+    table->maxHash = newMax;
+    table->changes += 1;
+
+    return table;
+}
+
+/**
+ * Detaches the buckets between lo and hi into a new hash table and shrinks the table to the rest of its
+ * range. The range has to start at minHash or end at maxHash but can not cover the whole table.
+ * No records are copied, the buckets are moved to the new table as they are. Only a bucket that
+ * is cut in two by the range has its entries copied
+ *
+ * @param table
+ * @param lo
+ * @param hi
+ * @return the detached hash table or NULL if the range can not be detached
+ */
+hash_table* hash_table_detach_range(hash_table *table, hash_t lo, hash_t hi) {
+    int atStart = lo == table->minHash && hi < table->maxHash;
+    int atEnd = hi == table->maxHash && lo > table->minHash;
+
+    if(lo > hi || (!atStart && !atEnd)) {
+        return NULL;
+    }
+
+    hash_table *detached = hash_table_create(lo, hi);
+    detached->mapping = table->mapping;
+
+    if(table->mapping) {
+        table->mapping->references += 1;
+    }
+
+    seq_write_begin(&table->seq);
+
+    bucket *from = &table->buckets[hash_table_bucket_index(table, lo)];
+    int len = hash_table_get_bucket_count(detached);
+    int shared = -1;
+
+    if(atStart && HASH_BUCKET(hi) == HASH_BUCKET(hi + 1)) {
+        shared = len - 1;
+    } else if(atEnd && HASH_BUCKET(lo - 1) == HASH_BUCKET(lo)) {
+        shared = 0;
+    }
+
+    for(int i = 0; i < len; i++) {
+        if(i == shared) {
+            bucket_split(&from[i], lo, hi, &detached->buckets[i]);
+        } else {
+            detached->buckets[i] = from[i];
+            memset(&from[i], 0, sizeof(from[i]));
         }
     }
 
-    hash_table_destroy(table);
+    if(atStart) {
+        table_resize(table, hi + 1, table->maxHash);
+    } else {
+        table_resize(table, table->minHash, lo - 1);
+    }
+
+    seq_write_end(&table->seq);
 
-    return newTable;
+    return detached;
 }
 
 /**
- * Frees the hash table and all of its contents
+ * Frees the hash table and all of its contents. Records are released a slab at a time.
+ * With HASH_CONCURRENT no reader can be using the table anymore
  *
  * @param table
  */
 void hash_table_destroy(hash_table *table) {
 
-    int len = table->maxHash - table->minHash;
+    int len = hash_table_get_bucket_count(table);
 
     for(int i = 0; i < len; i++ ) {
-        int bucketLen = table->buckets[i].length;
+        bucket_release(&table->buckets[i]);
+    }
 
-        for(int j = 0; j < bucketLen; j++) {
-            free(table->buckets[i].list[j]->ssn);
-            free(table->buckets[i].list[j]->email);
-            free(table->buckets[i].list[j]->name);
-            free(table->buckets[i].list[j]);
-        }
-        table->buckets[i].length = 0;
-        free(table->buckets[i].list);
+    if(table->mapping) {
+        hash_table_mapping_release(table->mapping);
     }
 
     free(table->buckets);
@@ -108,38 +296,239 @@ void hash_table_destroy(hash_table *table) {
 }
 
 /**
- * Inserts a new entry to the hash table
+ * Inserts a new entry to the hash table, the name and email are copied into a single record.
+ * An entry with the same ssn is replaced.
  *
  * @param table
- * @param entry
+ * @param ssn
+ * @param name
+ * @param nameLength
+ * @param email
+ * @param emailLength
  * @return a status, -1 means the hash index is outside the hash range and 0 means success.
  */
-int hash_table_insert(hash_table *table, hash_table_entry *entry) {
-    hash_t hash = hash_ssn(entry->ssn);
+int hash_table_insert(hash_table *table, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength) {
+    hash_t hash = hash_ssn((char*)ssn);
 
     if(hash < table->minHash || hash > table->maxHash) {
         return -1;
     }
 
-    hash_t index = hash - table->minHash;
+    hash_table_bucket_insert(&table->buckets[hash_table_bucket_index(table, hash)], ssn, name, nameLength, email, emailLength);
+    table->changes += 1;
+
+    return 0;
+}
+
+/**
+ * Inserts many entries at once. The ssns are hashed together with hash_ssn_batch and every bucket is grown
+ * once for all of its new entries before they are inserted, records outside the hash range are skipped
+ *
+ * @param table
+ * @param records
+ * @param count
+ * @param statuses filled with the status of every record like hash_table_insert would return it
+ * @return the number of records inserted
+ */
+int hash_table_insert_batch(hash_table *table, const hash_table_record *records, int count, int *statuses) {
+    char *ssns[HASH_TABLE_BATCH];
+    hash_t hashes[HASH_TABLE_BATCH];
+    int indices[HASH_TABLE_BATCH];
+    int incoming[1 << HASH_BUCKET_BITS];
+    int inserted = 0;
+
+    for(int start = 0; start < count; start += HASH_TABLE_BATCH) {
+        int len = count - start < HASH_TABLE_BATCH ? count - start : HASH_TABLE_BATCH;
+
+        for(int i = 0; i < len; i++) {
+            ssns[i] = (char*)records[start + i].ssn;
+        }
+
+        hash_ssn_batch(ssns, len, hashes);
+
+        for(int i = 0; i < len; i++) {
+            if(hashes[i] < table->minHash || hashes[i] > table->maxHash) {
+                indices[i] = -1;
+                continue;
+            }
+
+            indices[i] = hash_table_bucket_index(table, hashes[i]);
+            incoming[indices[i]] = 0;
+        }
+
+        for(int i = 0; i < len; i++) {
+            if(indices[i] >= 0) {
+                incoming[indices[i]] += 1;
+            }
+        }
+
+        for(int i = 0; i < len; i++) {
+            if(indices[i] >= 0 && incoming[indices[i]] > 0) {
+                bucket_reserve(&table->buckets[indices[i]], incoming[indices[i]]);
+                incoming[indices[i]] = 0;
+            }
+        }
+
+        //The buckets keep their arrays from here on, so what every insert reads is fetched before the first one
+        for(int i = 0; i < len; i++) {
+            if(indices[i] >= 0) {
+                bucket_prefetch(&table->buckets[indices[i]], ssn_pack(ssns[i]));
+            }
+        }
+
+        for(int i = 0; i < len; i++) {
+            const hash_table_record *record = &records[start + i];
+
+            statuses[start + i] = indices[i] < 0 ? -1 : 0;
+
+            if(indices[i] >= 0) {
+                hash_table_bucket_insert(&table->buckets[indices[i]], record->ssn, record->name, record->nameLength, record->email, record->emailLength);
+                inserted += 1;
+            }
+        }
+    }
+
+    table->changes += inserted;
+
+    return inserted;
+}
+
+/**
+ * Inserts a new entry into a bucket, the ssn has to hash to the bucket. Buckets are independent of each
+ * other so different buckets of a table can be filled from different threads
+ *
+ * @param b
+ * @param ssn
+ * @param name
+ * @param nameLength
+ * @param email
+ * @param emailLength
+ */
+void hash_table_bucket_insert(bucket *b, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength) {
+    seq_write_begin(&b->seq);
+    bucket_insert(b, ssn, name, nameLength, email, emailLength);
+    seq_write_end(&b->seq);
+}
+
+/**
+ * hash_table_bucket_insert without the sequence count of the bucket
+ *
+ * @param b
+ * @param ssn
+ * @param name
+ * @param nameLength
+ * @param email
+ * @param emailLength
+ */
+static void bucket_insert(bucket *b, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength) {
+    uint64_t key = ssn_pack(ssn);
+    int rawLength = RECORD_SSN_LENGTH(key);
+
+#if RECORD_DICTIONARY
+    uint8_t encodedName[DICTIONARY_FIELD_MAX];
+    uint8_t encodedEmail[DICTIONARY_FIELD_MAX];
+    uint8_t flags = 0;
+    int encodedLength = dictionary_encode(name, nameLength, encodedName);
+
+    if(encodedLength < 0) {
+        flags |= RECORD_RAW_NAME;
+    } else {
+        nameLength = encodedLength;
+        name = (const char*)encodedName;
+    }
+
+    encodedLength = dictionary_encode(email, emailLength, encodedEmail);
+
+    if(encodedLength < 0) {
+        flags |= RECORD_RAW_EMAIL;
+    } else {
+        emailLength = encodedLength;
+        email = (const char*)encodedEmail;
+    }
+#endif
+
+    uint8_t *record = slab_alloc(&b->records, rawLength + 2 + nameLength + emailLength + RECORD_FLAGS_LENGTH);
+    memcpy(record, ssn, rawLength);
+    uint8_t *body = record + rawLength;
+    body[0] = nameLength;
+    memcpy(body + 1, name, nameLength);
+    body[1 + nameLength] = emailLength;
+    memcpy(body + 2 + nameLength, email, emailLength);
+#if RECORD_DICTIONARY
+    body[2 + nameLength + emailLength] = flags;
+#endif
 
-    int listLen = 0;
+    int listIndex = bucket_filter_contains(b, key) ? hash_table_lookup_index(b, key, ssn) : -1;
 
-    if(table->buckets[index].list != NULL){
-        listLen = table->buckets[index].length;
+    if(listIndex >= 0) {
+        hash_table_slot *slot = &b->slots[listIndex];
+        slab_free(&b->records, slot->record, record_size(slot));
+        slot->record = record;
+        return;
     }
 
-    table->buckets[index].list = realloc(table->buckets[index].list, (listLen+1) * sizeof(hash_table_entry*));
+    if((b->length + b->tombstones + 1) * 4 > b->capacity * 3) {
+        //Rehashing drops the tombstones, the capacity only doubles if the entries need it
+        int capacity = b->capacity == 0 ? BUCKET_MIN_CAPACITY : b->capacity;
 
-    if(!table->buckets[index].list) {
-        perror("table->buckets[index].list || calloc");
+        if((b->length + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+        bucket_rehash(b, capacity);
     }
 
-    table->buckets[index].length += 1;
+    uint32_t probe = hash_key_probe(key);
+    int index = bucket_find_free(b, probe);
+
+    if(b->tags[index] == TAG_DELETED) {
+        b->tombstones -= 1;
+    }
 
-    table->buckets[index].list[table->buckets[index].length-1] = entry;
+    b->slots[index].key = key;
+    b->slots[index].record = record;
+    bucket_set_tag(b, index, TAG_FINGERPRINT(probe));
+    bucket_filter_add(b, key);
+    b->length += 1;
+}
 
-    return 0;
+/**
+ * Grows a bucket so incoming more entries fit without rehashing while they are inserted
+ *
+ * @param b
+ * @param incoming
+ */
+static void bucket_reserve(bucket *b, int incoming) {
+    if((b->length + b->tombstones + incoming) * 4 <= b->capacity * 3) {
+        return;
+    }
+
+    int capacity = b->capacity == 0 ? BUCKET_MIN_CAPACITY : b->capacity;
+
+    while((b->length + incoming) * 2 > capacity) {
+        capacity *= 2;
+    }
+
+    seq_write_begin(&b->seq);
+    bucket_rehash(b, capacity);
+    seq_write_end(&b->seq);
+}
+
+/**
+ * Prefetches the filter word, the first tag group and the first slot a key is probed at
+ *
+ * @param b
+ * @param key
+ */
+static void bucket_prefetch(const bucket *b, uint64_t key) {
+    if(b->capacity == 0) {
+        return;
+    }
+
+    int index = (int)(hash_key_probe(key) & (b->capacity - 1));
+
+    __builtin_prefetch(&b->filter[hash_key_filter(key) & (b->filterWords - 1)], 1);
+    __builtin_prefetch(&b->tags[index], 1);
+    __builtin_prefetch(&b->slots[index], 1);
 }
 
 /**
@@ -156,25 +545,31 @@ int hash_table_remove(hash_table *table, char *ssn) {
         return -1;
     }
 
-    hash_t hashIndex = hash-table->minHash;
-
-    int listIndex = hash_table_lookup_index(&table->buckets[hashIndex], ssn);
+    if(hash_table_bucket_remove(&table->buckets[hash_table_bucket_index(table, hash)], ssn)) {
+        table->changes += 1;
+    }
 
-    if(listIndex >= 0) {
-        free(table->buckets[hashIndex].list[listIndex]->ssn);
-        free(table->buckets[hashIndex].list[listIndex]->email);
-        free(table->buckets[hashIndex].list[listIndex]->name);
-        free(table->buckets[hashIndex].list[listIndex]);
+    return 0;
+}
 
-        for(int i = listIndex; i < table->buckets[hashIndex].length - 1; i++) {
-            table->buckets[hashIndex].list[i] = table->buckets[hashIndex].list[i+1];
-        }
+/**
+ * Removes an entry from a bucket by leaving a tombstone in its slot, the ssn has to hash to the bucket
+ *
+ * @param b
+ * @param ssn
+ * @return 1 if an entry was removed and 0 if the ssn was missing
+ */
+int hash_table_bucket_remove(bucket *b, const char *ssn) {
+    uint64_t key = ssn_pack(ssn);
+    int listIndex = bucket_filter_contains(b, key) ? hash_table_lookup_index(b, key, ssn) : -1;
 
-        table->buckets[hashIndex].list = realloc(table->buckets[hashIndex].list, (table->buckets[hashIndex].length - 1) * sizeof(hash_table_entry*));
-        table->buckets[hashIndex].length -= 1;
+    if(listIndex < 0) {
+        return 0;
     }
 
-    return 0;
+    bucket_remove_slot(b, listIndex);
+
+    return 1;
 }
 
 /**
@@ -183,23 +578,23 @@ int hash_table_remove(hash_table *table, char *ssn) {
  * @param table
  */
 void hash_table_print(hash_table *table) {
-    int len = table->maxHash - table->minHash;
+    int len = hash_table_get_bucket_count(table);
 
     printf("--------------TABLE-------------\n");
     printf("Amount of buckets: %d\n", len);
 
 
     for(int i = 0; i < len; i++) {
-        int bucketLen = table->buckets[i].length;
+        bucket *b = &table->buckets[i];
 
-        printf("Buckets[%d] length: %d\n", i, bucketLen);
+        printf("Buckets[%d] length: %d\n", i, b->length);
 
-        if(table->buckets[i].list) {
-            for(int j = 0; j < bucketLen; j++) {
-                printf("Buckets[%d][%d] ssn: %s\n", i, j, table->buckets[i].list[j]->ssn);
-                printf("Buckets[%d][%d] email: %s\n", i, j, table->buckets[i].list[j]->email);
-                printf("Buckets[%d][%d] name: %s\n", i, j, table->buckets[i].list[j]->name);
-            }
+        hash_table_entry entry;
+
+        for(int j = hash_table_bucket_next(b, 0, &entry); j >= 0; j = hash_table_bucket_next(b, j + 1, &entry)) {
+            printf("Buckets[%d][%d] ssn: %.12s\n", i, j, entry.ssn);
+            printf("Buckets[%d][%d] email: %.*s\n", i, j, entry.emailLength, entry.email);
+            printf("Buckets[%d][%d] name: %.*s\n", i, j, entry.nameLength, entry.name);
         }
 
     }
@@ -207,94 +602,1121 @@ void hash_table_print(hash_table *table) {
 }
 
 /**
- * Creates an entry for the hash table
+ * Compacts buckets where more than 1/COMPACT_RATIO of the slots are tombstones. The buckets are visited
+ * round robin from where the last call stopped so an idle node can compact a little at a time.
+ * A compacted bucket is rehashed into the smallest capacity that is at most half full and a bucket
+ * with tombstones but no entries gives back all of its memory
  *
- * @param ssn
- * @param name
- * @param email
- * @return a new entry pointer for the hash table
+ * @param table
+ * @param budget the most buckets to compact
+ * @return the number of compacted buckets
  */
-hash_table_entry *hash_table_create_entry(const char *ssn, char *name, char *email) {
-    hash_table_entry *entry = malloc(sizeof(*entry));
+int hash_table_compact(hash_table *table, int budget) {
+    int span = hash_table_get_bucket_count(table);
+    int compacted = 0;
+
+    for(int i = 0; i < span && compacted < budget; i++) {
+        table->compactCursor = (table->compactCursor + 1) % span;
+        bucket *b = &table->buckets[table->compactCursor];
+
+        if(b->tombstones == 0 || (b->length > 0 && b->tombstones * COMPACT_RATIO <= b->capacity)) {
+            continue;
+        }
+
+        seq_write_begin(&b->seq);
 
-    entry->ssn = calloc(12, sizeof(char));
-    entry->name = calloc(strlen(name) + 1, sizeof(char));
-    entry->email = calloc(strlen(email) + 1, sizeof(char));
+        if(b->length == 0) {
+            bucket_release(b);
+        } else {
+            int capacity = BUCKET_MIN_CAPACITY;
 
-    for(int i = 0; i < 12; i++) {
-        entry->ssn[i] = ssn[i];
+            while(b->length * 2 > capacity) {
+                capacity *= 2;
+            }
+            bucket_rehash(b, capacity);
+        }
+
+        seq_write_end(&b->seq);
+        compacted += 1;
     }
 
-    strcpy(entry->name, name);
-    strcpy(entry->email, email);
+    return compacted;
+}
+
+/**
+ * Looks up a value in the hash table depending on the ssn, entry->name is left NULL when the ssn is missing.
+ * The lookup counts towards the filter stats
+ *
+ * @param table
+ * @param ssn
+ * @param entry
+ * @return status, -1 means hash is outside the hash range and 0 means success
+ */
+int hash_table_lookup(hash_table *table, const char* ssn, hash_table_entry *entry){
+    return table_lookup(table, ssn, entry, 1);
+}
 
-    return entry;
+/**
+ * Checks if the table has an ssn like hash_table_lookup, but leaves the filter stats alone. It is meant
+ * for the node itself, like the ssn index, so the stats only show what clients looked up
+ *
+ * @param table
+ * @param ssn
+ * @param entry filled with the entry if it is found
+ * @return 1 if the table has the ssn, 0 otherwise
+ */
+int hash_table_contains(hash_table *table, const char *ssn, hash_table_entry *entry) {
+    return table_lookup(table, ssn, entry, 0) == 0 && entry->name != NULL;
 }
 
 /**
- * Looks up a value in the hash table depending on the ssn
+ * Looks up an ssn for hash_table_lookup and hash_table_contains
  *
  * @param table
  * @param ssn
  * @param entry
+ * @param counted 1 if the filter stats count the lookup
  * @return status, -1 means hash is outside the hash range and 0 means success
  */
-int hash_table_lookup(hash_table *table, char* ssn, hash_table_entry *entry){
-    hash_t hash = hash_ssn(ssn);
+static int table_lookup(hash_table *table, const char *ssn, hash_table_entry *entry, int counted) {
+    hash_t hash = hash_ssn((char*)ssn);
 
     if (hash < table->minHash || hash > table->maxHash){
         return -1;
     }
 
-    int index = hash_table_lookup_index(&table->buckets[hash - table->minHash], ssn);
+    bucket *b = &table->buckets[hash_table_bucket_index(table, hash)];
+
+    uint64_t key = ssn_pack(ssn);
+
+    if(!bucket_filter_contains(b, key)) {
+        table->filterRejects += counted;
+        entry->name = NULL;
+        return 0;
+    }
+
+    int index = hash_table_lookup_index(b, key, ssn);
 
     if (index != -1){
-        *entry = *table->buckets[hash-table->minHash].list[index];
+        record_to_entry(&b->slots[index], entry);
+    } else {
+        table->filterFalsePositives += counted;
+        entry->name = NULL;
     }
 
     return 0;
 }
 
+#if HASH_CONCURRENT
 /**
- * Returns buckets in range between min parameter and max hash
+ * Looks up an ssn like hash_table_lookup from a reader thread while the writer changes the table. The record
+ * is copied into the record buffer and the entry points into it instead of the table.
+ *
+ * The range, the bucket and then the record are read optimistically and read again whenever the writer
+ * changed the table or the bucket in the meantime. Memory the writer replaces is not freed until the reader
+ * leaves its epoch, so a read that races with a change only ever sees stale bytes and retries.
+ * The caller has to be inside epoch_enter, also while it loads the table pointer
  *
  * @param table
- * @param min
- * @return the buckets in range between minparameter and max hash
+ * @param ssn
+ * @param entry
+ * @param record
+ * @return status, -1 means hash is outside the hash range and 0 means success
  */
-bucket *hash_table_get_buckets_from(hash_table *table, uint8_t min) {
-    return table->buckets + min;
+int hash_table_lookup_concurrent(hash_table *table, const char *ssn, hash_table_entry *entry, uint8_t record[HASH_TABLE_RECORD_MAX]) {
+    hash_t hash = hash_ssn((char*)ssn);
+    uint64_t key = ssn_pack(ssn);
+    int status;
+
+    while(1) {
+        unsigned int tableSeq = seq_read_begin(&table->seq);
+        hash_t minHash = table->minHash;
+        hash_t maxHash = table->maxHash;
+        bucket *buckets = table->buckets;
+
+        if(seq_read_retry(&table->seq, tableSeq)) {
+            continue;
+        }
+
+        if(hash < minHash || hash > maxHash) {
+            status = -1;
+            break;
+        }
+
+        bucket *b = &buckets[HASH_BUCKET(hash) - HASH_BUCKET(minHash)];
+        unsigned int bucketSeq = seq_read_begin(&b->seq);
+        bucket snapshot = *b;
+
+        if(lookup_changed(table, tableSeq, b, bucketSeq)) {
+            continue;
+        }
+
+        //The arrays of the snapshot belong together and stay allocated, their contents are checked below
+        int index = bucket_filter_contains(&snapshot, key) ? hash_table_lookup_index(&snapshot, key, ssn) : -1;
+
+        if(index < 0) {
+            if(lookup_changed(table, tableSeq, b, bucketSeq)) {
+                continue;
+            }
+
+            entry->name = NULL;
+            status = 0;
+            break;
+        }
+
+        hash_table_slot slot = snapshot.slots[index];
+
+        if(!slot.record || lookup_changed(table, tableSeq, b, bucketSeq)) {
+            continue;
+        }
+
+        //Every length is checked before it is used as an offset so a record that was freed and reused in
+        //the meantime is never read past the end of its allocation
+        int offset = RECORD_SSN_LENGTH(slot.key);
+        uint8_t nameLength = slot.record[offset];
+
+        if(lookup_changed(table, tableSeq, b, bucketSeq)) {
+            continue;
+        }
+
+        uint8_t emailLength = slot.record[offset + 1 + nameLength];
+
+        if(lookup_changed(table, tableSeq, b, bucketSeq)) {
+            continue;
+        }
+
+        memcpy(record, slot.record, offset + 2 + nameLength + emailLength + RECORD_FLAGS_LENGTH);
+
+        if(lookup_changed(table, tableSeq, b, bucketSeq)) {
+            continue;
+        }
+
+        slot.record = record;
+        record_to_entry(&slot, entry);
+        status = 0;
+        break;
+    }
+
+    return status;
 }
+#endif
 
 /**
- * Returns the span between min and max
+ * Collects the memory use and false positive rate of the bloom filters of a table. A missing ssn hits a
+ * filter word with a fraction f of its bits set and gets past it with a chance of f^FILTER_HASHES, the
+ * estimate is that averaged over the buckets of the range
  *
  * @param table
- * @return the span between min and max
+ * @param stats
  */
-int hash_table_get_span(hash_table *table) {
-    return (table->maxHash - table->minHash) + 1;
+void hash_table_get_filter_stats(hash_table *table, hash_table_filter_stats *stats) {
+    int len = hash_table_get_bucket_count(table);
+    double rate = 0;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for(int i = 0; i < len; i++) {
+        bucket *b = &table->buckets[i];
+
+        if(!b->filter) {
+            continue;
+        }
+
+        double bucketRate = 0;
+
+        for(int j = 0; j < b->filterWords; j++) {
+            double fill = __builtin_popcountll(b->filter[j]) / 64.0;
+            bucketRate += fill * fill * fill;
+        }
+
+        rate += bucketRate / b->filterWords;
+        stats->bytes += b->filterWords * sizeof(*b->filter);
+        stats->entries += b->length;
+    }
+
+    stats->estimatedFalsePositiveRate = len > 0 ? rate / len : 0;
+    stats->rejects = table->filterRejects;
+    stats->falsePositives = table->filterFalsePositives;
 }
 
 /**
- * Returns the index for an ssn inside a bucket
+ * Finds the first occupied slot of a bucket at or after index and fills in its entry
  *
  * @param b
- * @param ssn
- * @returnan index for an ssn inside a bucket
- */
-static int hash_table_lookup_index(bucket *b, const char *ssn){
-    for(int i = 0; i < b->length; i++){
-        int found = 0;
-        for(int j = 0; j < 12; j++) {
-            if(ssn[j] != b->list[i]->ssn[j]) {
-                found = -1;
-                break;
-            }
-        }
-        if(found == 0) {
+ * @param index
+ * @param entry
+ * @return the slot index of the entry or -1 when there are no more entries
+ */
+int hash_table_bucket_next(bucket *b, int index, hash_table_entry *entry) {
+    for(int i = index; i < b->capacity; i++) {
+        if(b->slots[i].record) {
+            record_to_entry(&b->slots[i], entry);
             return i;
         }
     }
+
     return -1;
-}
\ No newline at end of file
+}
+
+/**
+ * Saves the hash table to a file that can be mapped back with hash_table_open. The file is written next to
+ * path and renamed over it once it is synced so a crash never leaves a half written table behind
+ *
+ * @param table
+ * @param path
+ * @return a status, -1 means the file could not be written and 0 means success
+ */
+int hash_table_save(hash_table *table, const char *path) {
+    char tmpPath[strlen(path) + 5];
+    sprintf(tmpPath, "%s.tmp", path);
+
+    FILE *file = fopen(tmpPath, "wb");
+
+    if(!file) {
+        perror("hash_table_save || fopen");
+        return -1;
+    }
+
+    int span = hash_table_get_bucket_count(table);
+    file_header header = {FILE_MAGIC, FILE_VERSION, table->minHash, table->maxHash, HASH_BITS, HASH_FUNCTION, RECORD_WIRE, RECORD_DICTIONARY, {0}, 0, 0};
+    file_bucket *directory = calloc(span, sizeof(*directory));
+    uint64_t offset = sizeof(header) + span * sizeof(*directory);
+
+    for(int i = 0; i < span; i++) {
+        bucket *b = &table->buckets[i];
+
+        directory[i].capacity = b->capacity;
+        directory[i].length = b->length;
+
+        if(b->capacity > 0) {
+            directory[i].slots = offset;
+            offset += b->capacity * sizeof(hash_table_slot);
+            directory[i].tags = offset;
+            offset += FILE_ALIGN(b->capacity + FILE_GROUP_WIDTH);
+        }
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(directory, sizeof(*directory), span, file);
+
+    uint8_t padding[FILE_GROUP_WIDTH + SLAB_GRANULARITY];
+    memset(padding, TAG_EMPTY, sizeof(padding));
+
+    for(int i = 0; i < span; i++) {
+        bucket *b = &table->buckets[i];
+
+        for(int j = 0; j < b->capacity; j++) {
+            hash_table_slot slot = {b->slots[j].key, NULL};
+
+            if(TAG_IS_FULL(b->tags[j])) {
+                slot.record = (uint8_t*)(uintptr_t)offset;
+                offset += slab_size(record_size(&b->slots[j]));
+            }
+            fwrite(&slot, sizeof(slot), 1, file);
+        }
+
+        if(b->capacity > 0) {
+            fwrite(b->tags, 1, b->capacity, file);
+            fwrite(padding, 1, FILE_ALIGN(b->capacity + FILE_GROUP_WIDTH) - b->capacity, file);
+        }
+    }
+
+    for(int i = 0; i < span; i++) {
+        bucket *b = &table->buckets[i];
+
+        for(int j = 0; j < b->capacity; j++) {
+            if(TAG_IS_FULL(b->tags[j])) {
+                size_t size = record_size(&b->slots[j]);
+
+                fwrite(b->slots[j].record, 1, size, file);
+                fwrite(padding, 1, slab_size(size) - size, file);
+            }
+        }
+    }
+
+#if RECORD_DICTIONARY
+    header.dictionary = offset;
+    offset += dictionary_save(file);
+#endif
+
+    header.size = offset;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    free(directory);
+
+    if(fflush(file) != 0 || fsync(fileno(file)) != 0 || ferror(file)) {
+        perror("hash_table_save || write");
+        fclose(file);
+        unlink(tmpPath);
+        return -1;
+    }
+
+    fclose(file);
+
+    if(rename(tmpPath, path) != 0) {
+        perror("hash_table_save || rename");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Maps a file written by hash_table_save into memory and returns a hash table serving from it. Only the
+ * record pointers of the slots are fixed up, records stay in the mapping until they are removed
+ *
+ * @param path
+ * @return The hash table pointer or NULL if the file is missing or not a table file
+ */
+hash_table* hash_table_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(file_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    uint8_t *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(base == MAP_FAILED) {
+        perror("hash_table_open || mmap");
+        return NULL;
+    }
+
+    file_header *header = (file_header*)base;
+
+    if(header->magic != FILE_MAGIC || header->version != FILE_VERSION || header->size != (uint64_t)st.st_size
+       || header->minHash > header->maxHash || header->maxHash > HASH_MAX) {
+        fprintf(stderr, "hash_table_open: %s is not a table file\n", path);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    if(header->hashBits != HASH_BITS || header->hashFunction != HASH_FUNCTION) {
+        fprintf(stderr, "hash_table_open: %s was saved with a %d bit keyspace and hash function %d, this node uses %d bits and hash function %d\n",
+                path, header->hashBits, header->hashFunction, HASH_BITS, HASH_FUNCTION);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    if(header->recordWire != RECORD_WIRE) {
+        fprintf(stderr, "hash_table_open: %s was saved with RECORD_WIRE %d, this node uses %d\n", path, header->recordWire, RECORD_WIRE);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    if(header->recordDictionary != RECORD_DICTIONARY) {
+        fprintf(stderr, "hash_table_open: %s was saved with RECORD_DICTIONARY %d, this node uses %d\n", path, header->recordDictionary, RECORD_DICTIONARY);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+#if RECORD_DICTIONARY
+    if(header->dictionary < sizeof(*header) || header->dictionary > header->size
+       || dictionary_load(base + header->dictionary, header->size - header->dictionary) < 0) {
+        fprintf(stderr, "hash_table_open: the dictionary of %s does not match the dictionary of this node\n", path);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+#endif
+
+    int span = HASH_BUCKET(header->maxHash) - HASH_BUCKET(header->minHash) + 1;
+
+    if(sizeof(*header) + span * sizeof(file_bucket) > header->size) {
+        fprintf(stderr, "hash_table_open: %s is not a table file\n", path);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    if(!file_valid(base, header, span)) {
+        fprintf(stderr, "hash_table_open: the buckets of %s are corrupt\n", path);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    hash_table *table = hash_table_create(header->minHash, header->maxHash);
+    file_bucket *directory = (file_bucket*)(base + sizeof(*header));
+
+    table->mapping = malloc(sizeof(*table->mapping));
+    table->mapping->base = base;
+    table->mapping->size = st.st_size;
+    table->mapping->references = 1;
+
+    for(int i = 0; i < span; i++) {
+        bucket *b = &table->buckets[i];
+        uint32_t capacity = directory[i].capacity;
+
+        if(capacity == 0) {
+            continue;
+        }
+
+        b->slots = (hash_table_slot*)(base + directory[i].slots);
+        b->tags = base + directory[i].tags;
+        b->capacity = (int)capacity;
+        b->length = (int)directory[i].length;
+        b->mapped = 1;
+
+        for(int j = 0; j < b->capacity; j++) {
+            if(TAG_IS_FULL(b->tags[j])) {
+                b->slots[j].record = base + (uintptr_t)b->slots[j].record;
+                continue;
+            }
+
+            //A slot without an entry has no record whatever the file says
+            b->slots[j].record = NULL;
+
+            if(b->tags[j] == TAG_DELETED) {
+                b->tombstones += 1;
+            }
+        }
+
+        for(int j = 0; j < GROUP_WIDTH; j++) {
+            b->tags[b->capacity + j] = b->tags[j & (b->capacity - 1)];
+        }
+
+        bucket_filter_build(b);
+    }
+
+    return table;
+}
+
+/**
+ * Checks that a table file is laid out the way hash_table_save writes it before anything in the mapping is
+ * used: the slots and tags of the buckets one after the other behind the directory, then every record in
+ * slot order padded to its slab size, so no region overlaps another and every length stays inside the
+ * file. Every tag has to be a valid one and every bucket needs an empty slot, probing stops at one
+ *
+ * @param base the mapping of the file
+ * @param header with a directory of span buckets inside the file
+ * @param span
+ * @return 1 if the file can be used, 0 otherwise
+ */
+static int file_valid(const uint8_t *base, const file_header *header, int span) {
+    const file_bucket *directory = (const file_bucket*)(base + sizeof(*header));
+    uint64_t size = header->size;
+    uint64_t offset = sizeof(*header) + span * sizeof(*directory);
+
+    for(int i = 0; i < span; i++) {
+        uint64_t capacity = directory[i].capacity;
+
+        if(capacity == 0) {
+            if(directory[i].length != 0 || directory[i].slots != 0 || directory[i].tags != 0) {
+                return 0;
+            }
+            continue;
+        }
+
+        if((capacity & (capacity - 1)) != 0 || directory[i].length > capacity || directory[i].slots != offset) {
+            return 0;
+        }
+
+        offset += capacity * sizeof(hash_table_slot);
+
+        if(directory[i].tags != offset) {
+            return 0;
+        }
+
+        offset += FILE_ALIGN(capacity + FILE_GROUP_WIDTH);
+
+        if(offset > size) {
+            return 0;
+        }
+    }
+
+    for(int i = 0; i < span; i++) {
+        if(directory[i].capacity == 0) {
+            continue;
+        }
+
+        const hash_table_slot *slots = (const hash_table_slot*)(base + directory[i].slots);
+        const uint8_t *tags = base + directory[i].tags;
+        uint32_t records = 0;
+        uint32_t empty = 0;
+
+        for(uint32_t j = 0; j < directory[i].capacity; j++) {
+            if(tags[j] == TAG_EMPTY) {
+                empty += 1;
+                continue;
+            }
+
+            if(tags[j] == TAG_DELETED) {
+                continue;
+            }
+
+            //The name length is read once it is inside the file, then the email length
+            uint64_t end = offset + RECORD_SSN_LENGTH(slots[j].key) + 1;
+
+            if(!TAG_IS_FULL(tags[j]) || (uintptr_t)slots[j].record != offset || end > size) {
+                return 0;
+            }
+
+            end += base[end - 1] + 1;
+
+            if(end > size) {
+                return 0;
+            }
+
+            end += base[end - 1] + RECORD_FLAGS_LENGTH;
+
+            if(end > size || slab_size(end - offset) > size - offset) {
+                return 0;
+            }
+
+            offset += slab_size(end - offset);
+            records += 1;
+        }
+
+        if(records != directory[i].length || empty == 0) {
+            return 0;
+        }
+    }
+
+    return offset == (RECORD_DICTIONARY ? header->dictionary : size);
+}
+
+/**
+ * Returns buckets in range between min parameter and max hash
+ *
+ * @param table
+ * @param min
+ * @return the buckets in range between minparameter and max hash
+ */
+bucket *hash_table_get_buckets_from(hash_table *table, int index) {
+    return table->buckets + index;
+}
+
+/**
+ * Returns the span between min and max
+ *
+ * @param table
+ * @return the number of hashes between min and max, 0 when a 64 bit table covers the whole keyspace
+ */
+uint64_t hash_table_get_span(hash_table *table) {
+    return (uint64_t)(table->maxHash - table->minHash) + 1;
+}
+
+/**
+ * Returns the number of buckets of the table
+ *
+ * @param table
+ * @return the number of buckets between the buckets of min and max
+ */
+int hash_table_get_bucket_count(hash_table *table) {
+    return HASH_BUCKET(table->maxHash) - HASH_BUCKET(table->minHash) + 1;
+}
+
+/**
+ * Returns the index of the bucket a hash inside the range of the table belongs to
+ *
+ * @param table
+ * @param hash
+ * @return the bucket index
+ */
+int hash_table_bucket_index(hash_table *table, hash_t hash) {
+    return HASH_BUCKET(hash) - HASH_BUCKET(table->minHash);
+}
+
+/**
+ * Returns the slot index for an ssn inside a bucket
+ *
+ * @param b
+ * @param key the packed ssn
+ * @param ssn
+ * @return a slot index for an ssn inside a bucket or -1 if it is missing
+ */
+static int hash_table_lookup_index(bucket *b, uint64_t key, const char *ssn){
+    if(b->capacity == 0) {
+        return -1;
+    }
+
+    uint32_t probe = hash_key_probe(key);
+    uint8_t fingerprint = TAG_FINGERPRINT(probe);
+    int mask = b->capacity - 1;
+    int index = (int)(probe & mask);
+
+    while(1) {
+        uint32_t match = group_match(&b->tags[index], fingerprint);
+        uint32_t empty = group_match(&b->tags[index], TAG_EMPTY);
+
+        if(empty) {
+            //Slots after the first empty one belong to other probe runs
+            match &= (empty & -empty) - 1;
+        }
+
+        while(match) {
+            int i = (index + __builtin_ctz(match)) & mask;
+
+            //A concurrent reader can see the record of a slot that is being removed as NULL, so it is loaded once
+            const uint8_t *record = __atomic_load_n(&b->slots[i].record, __ATOMIC_RELAXED);
+
+            if(b->slots[i].key == key && (!(key & SSN_KEY_RAW) || (record && memcmp(record, ssn, SSN_LENGTH) == 0))) {
+                return i;
+            }
+            match &= match - 1;
+        }
+
+        if(empty) {
+            return -1;
+        }
+
+        index = (index + GROUP_WIDTH) & mask;
+    }
+}
+
+/**
+ * Rehashes a bucket into a new capacity, which drops every tombstone
+ *
+ * @param b
+ * @param capacity a power of two larger than the number of entries
+ */
+static void bucket_rehash(bucket *b, int capacity) {
+    int oldCapacity = b->capacity;
+    hash_table_slot *oldSlots = b->slots;
+    uint8_t *oldTags = b->tags;
+
+    b->capacity = capacity;
+    b->slots = calloc(b->capacity, sizeof(*b->slots));
+    b->tags = malloc(b->capacity + GROUP_WIDTH);
+
+    if(!b->slots || !b->tags) {
+        perror("b->slots || calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(b->tags, TAG_EMPTY, b->capacity + GROUP_WIDTH);
+
+    for(int i = 0; i < oldCapacity; i++) {
+        if(TAG_IS_FULL(oldTags[i])) {
+            uint32_t probe = hash_key_probe(oldSlots[i].key);
+            int index = bucket_find_free(b, probe);
+
+            b->slots[index] = oldSlots[i];
+            bucket_set_tag(b, index, oldTags[i]);
+        }
+    }
+
+    bucket_filter_build(b);
+
+    if(!b->mapped) {
+        RETIRE(oldSlots);
+        RETIRE(oldTags);
+    }
+    b->mapped = 0;
+    b->tombstones = 0;
+}
+
+/**
+ * Removes the entry in a slot by freeing its record and leaving a tombstone
+ *
+ * @param b
+ * @param index
+ */
+static void bucket_remove_slot(bucket *b, int index) {
+    hash_table_slot *slot = &b->slots[index];
+
+    seq_write_begin(&b->seq);
+
+    slab_free(&b->records, slot->record, record_size(slot));
+    slot->record = NULL;
+    bucket_set_tag(b, index, TAG_DELETED);
+    b->length -= 1;
+    b->tombstones += 1;
+
+    seq_write_end(&b->seq);
+}
+
+/**
+ * Moves the entries of a bucket whose hash is between lo and hi into another bucket
+ *
+ * @param b
+ * @param lo
+ * @param hi
+ * @param dest the bucket the entries are copied to, or NULL to drop them
+ */
+static void bucket_split(bucket *b, hash_t lo, hash_t hi, bucket *dest) {
+    hash_table_entry entry;
+
+    for(int i = hash_table_bucket_next(b, 0, &entry); i >= 0; i = hash_table_bucket_next(b, i + 1, &entry)) {
+        hash_t hash = hash_ssn(entry.ssn);
+
+        if(hash < lo || hash > hi) {
+            continue;
+        }
+
+        if(dest) {
+            hash_table_bucket_insert(dest, entry.ssn, entry.name, entry.nameLength, entry.email, entry.emailLength);
+        }
+        bucket_remove_slot(b, i);
+    }
+
+    //Forget the keys that moved out, the rest of the bucket is left as it is
+    if(b->filter) {
+        seq_write_begin(&b->seq);
+        bucket_filter_build(b);
+        seq_write_end(&b->seq);
+    }
+}
+
+/**
+ * Frees the slots and records of a bucket and leaves it empty
+ *
+ * @param b
+ */
+static void bucket_release(bucket *b) {
+#if HASH_CONCURRENT
+    //Readers can still be copying records out of the chunks
+    for(slab_chunk *chunk = b->records.chunks; chunk; ) {
+        slab_chunk *next = chunk->next;
+        epoch_retire(chunk);
+        chunk = next;
+    }
+
+    memset(&b->records, 0, sizeof(b->records));
+#else
+    slab_release(&b->records);
+#endif
+
+    if(!b->mapped) {
+        RETIRE(b->slots);
+        RETIRE(b->tags);
+    }
+
+    RETIRE(b->filter);
+
+    b->mapped = 0;
+    b->slots = NULL;
+    b->tags = NULL;
+    b->filter = NULL;
+    b->filterWords = 0;
+    b->capacity = 0;
+    b->length = 0;
+    b->tombstones = 0;
+}
+
+/**
+ * Unmaps a table file when the last hash table using it lets go of it
+ *
+ * @param mapping
+ */
+static void hash_table_mapping_release(hash_table_mapping *mapping) {
+    mapping->references -= 1;
+
+    if(mapping->references == 0) {
+        munmap(mapping->base, mapping->size);
+        free(mapping);
+    }
+}
+
+/**
+ * Finds the first empty or deleted slot of the probe run for a probe hash, the bucket must have an empty slot
+ *
+ * @param b
+ * @param probe
+ * @return the slot index
+ */
+static int bucket_find_free(bucket *b, uint32_t probe) {
+    int mask = b->capacity - 1;
+    int index = (int)(probe & mask);
+
+    while(1) {
+        uint32_t free = group_match_free(&b->tags[index]);
+
+        if(free) {
+            return (index + __builtin_ctz(free)) & mask;
+        }
+
+        index = (index + GROUP_WIDTH) & mask;
+    }
+}
+
+/**
+ * Sets the tag of a slot. The first GROUP_WIDTH tags are mirrored after the last slot so a group can
+ * always be loaded from any slot without wrapping around
+ *
+ * @param b
+ * @param index
+ * @param tag
+ */
+static void bucket_set_tag(bucket *b, int index, uint8_t tag) {
+    b->tags[index] = tag;
+
+    for(int i = index; i < GROUP_WIDTH; i += b->capacity) {
+        b->tags[b->capacity + i] = tag;
+    }
+}
+
+/**
+ * Compares a group of GROUP_WIDTH tags to a tag
+ *
+ * @param tags
+ * @param tag
+ * @return a bit mask where bit i is set if tags[i] equals the tag
+ */
+static uint32_t group_match(const uint8_t *tags, uint8_t tag) {
+#if defined(__AVX2__)
+    __m256i group = _mm256_loadu_si256((const __m256i*)tags);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8((char)tag)));
+#elif defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*)tags);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+    uint32_t match = 0;
+    for(int i = 0; i < GROUP_WIDTH; i++) {
+        match |= (uint32_t)(tags[i] == tag) << i;
+    }
+    return match;
+#endif
+}
+
+/**
+ * Finds the empty and deleted tags in a group of GROUP_WIDTH tags, they are the tags with the high bit set
+ *
+ * @param tags
+ * @return a bit mask where bit i is set if tags[i] is empty or deleted
+ */
+static uint32_t group_match_free(const uint8_t *tags) {
+#if defined(__AVX2__)
+    return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)tags));
+#elif defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)tags));
+#else
+    uint32_t match = 0;
+    for(int i = 0; i < GROUP_WIDTH; i++) {
+        match |= (uint32_t)(!TAG_IS_FULL(tags[i])) << i;
+    }
+    return match;
+#endif
+}
+
+/**
+ * Returns the size of the record in a slot
+ *
+ * @param slot
+ * @return the size in bytes
+ */
+static size_t record_size(const hash_table_slot *slot) {
+    int rawLength = RECORD_SSN_LENGTH(slot->key);
+    const uint8_t *record = slot->record + rawLength;
+
+    return rawLength + 2 + record[0] + record[1 + record[0]] + RECORD_FLAGS_LENGTH;
+}
+
+/**
+ * Fills in an entry view of the record in a slot, with RECORD_DICTIONARY the record is decoded into the entry
+ *
+ * @param slot
+ * @param entry
+ */
+static void record_to_entry(const hash_table_slot *slot, hash_table_entry *entry) {
+    const uint8_t *record = slot->record;
+
+    if(RECORD_SSN_LENGTH(slot->key)) {
+        memcpy(entry->ssn, record, SSN_LENGTH);
+        entry->wire = record;
+        record += SSN_LENGTH;
+    } else {
+        ssn_unpack(slot->key, entry->ssn);
+        entry->wire = NULL;
+    }
+
+#if RECORD_DICTIONARY
+    uint8_t *decoded = entry->decoded;
+
+    uint8_t flags = record[2 + record[0] + record[1 + record[0]]];
+
+    decoded[0] = dictionary_decode(record + 1, record[0], flags & RECORD_RAW_NAME, decoded + 1);
+    decoded[1 + decoded[0]] = dictionary_decode(record + 2 + record[0], record[1 + record[0]], flags & RECORD_RAW_EMAIL, decoded + 2 + decoded[0]);
+    record = decoded;
+#endif
+
+    entry->nameLength = record[0];
+    entry->name = (const char*)record + 1;
+    entry->emailLength = record[1 + record[0]];
+    entry->email = (const char*)record + 2 + record[0];
+    entry->fields = record;
+    entry->fieldsLength = 2 + entry->nameLength + entry->emailLength;
+}
+
+/**
+ * Allocates a bloom filter of FILTER_BITS_PER_SLOT bits per slot for a bucket and adds every entry to it
+ *
+ * @param b
+ */
+static void bucket_filter_build(bucket *b) {
+    RETIRE(b->filter);
+
+    b->filterWords = b->capacity * FILTER_BITS_PER_SLOT / 64;
+    b->filter = calloc(b->filterWords, sizeof(*b->filter));
+
+    if(!b->filter) {
+        perror("b->filter || calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for(int i = 0; i < b->capacity; i++) {
+        if(TAG_IS_FULL(b->tags[i])) {
+            bucket_filter_add(b, b->slots[i].key);
+        }
+    }
+}
+
+/**
+ * Adds a key to the bloom filter of a bucket
+ *
+ * @param b
+ * @param key
+ */
+static void bucket_filter_add(bucket *b, uint64_t key) {
+    uint64_t hash = hash_key_filter(key);
+
+    b->filter[hash & (b->filterWords - 1)] |= filter_mask(hash);
+}
+
+/**
+ * Checks if a key might be in a bucket
+ *
+ * @param b
+ * @param key
+ * @return 0 if the key is not in the bucket, 1 if it might be
+ */
+static int bucket_filter_contains(const bucket *b, uint64_t key) {
+    if(!b->filter) {
+        return 0;
+    }
+
+    uint64_t hash = hash_key_filter(key);
+    uint64_t mask = filter_mask(hash);
+
+    return (b->filter[hash & (b->filterWords - 1)] & mask) == mask;
+}
+
+/**
+ * Returns the FILTER_HASHES bits a key sets in its filter word. The word is picked by the low bits of the
+ * hash and the bits by the top six bit groups so the two do not overlap
+ *
+ * @param hash
+ * @return the bits
+ */
+static uint64_t filter_mask(uint64_t hash) {
+    uint64_t mask = 0;
+
+    for(int i = 1; i <= FILTER_HASHES; i++) {
+        mask |= UINT64_C(1) << ((hash >> (64 - 6 * i)) & 63);
+    }
+
+    return mask;
+}
+
+/**
+ * Changes the length of the bucket directory of a table. With HASH_CONCURRENT readers can still be
+ * reading the old directory so it is copied and retired instead of reallocated
+ *
+ * @param buckets
+ * @param oldSpan
+ * @param newSpan
+ * @return the new directory
+ */
+static bucket *buckets_resize(bucket *buckets, int oldSpan, int newSpan) {
+#if HASH_CONCURRENT
+    bucket *resized = malloc(newSpan * sizeof(*resized));
+
+    if(!resized) {
+        perror("table->buckets || malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(resized, buckets, (oldSpan < newSpan ? oldSpan : newSpan) * sizeof(*resized));
+    epoch_retire(buckets);
+#else
+    (void)oldSpan;
+    bucket *resized = realloc(buckets, newSpan * sizeof(*resized));
+
+    if(!resized) {
+        perror("table->buckets || realloc");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    return resized;
+}
+
+/**
+ * Starts a change that readers have to retry around, the count is odd until seq_write_end
+ *
+ * @param seq
+ */
+static void seq_write_begin(unsigned int *seq) {
+#if HASH_CONCURRENT
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#else
+    (void)seq;
+#endif
+}
+
+/**
+ * Ends a change started by seq_write_begin
+ *
+ * @param seq
+ */
+static void seq_write_end(unsigned int *seq) {
+#if HASH_CONCURRENT
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+#else
+    (void)seq;
+#endif
+}
+
+#if HASH_CONCURRENT
+/**
+ * Waits until no change is in progress and returns the sequence count to check the read against
+ *
+ * @param seq
+ * @return the sequence count
+ */
+static unsigned int seq_read_begin(const unsigned int *seq) {
+    unsigned int start;
+
+    while((start = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1) {
+#if defined(__SSE2__)
+        _mm_pause();
+#endif
+    }
+
+    return start;
+}
+
+/**
+ * Checks if a change started since seq_read_begin, the reads before it have to be done again then
+ *
+ * @param seq
+ * @param start
+ * @return 1 if the reads have to be retried, 0 if they saw a consistent bucket
+ */
+static int seq_read_retry(const unsigned int *seq, unsigned int start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+/**
+ * Checks if the table or the bucket a lookup reads from changed since the lookup started
+ *
+ * @param table
+ * @param tableSeq
+ * @param b
+ * @param bucketSeq
+ * @return 1 if the lookup has to start over
+ */
+static int lookup_changed(const hash_table *table, unsigned int tableSeq, const bucket *b, unsigned int bucketSeq) {
+    return seq_read_retry(&b->seq, bucketSeq) || seq_read_retry(&table->seq, tableSeq);
+}
+#endif
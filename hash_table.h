@@ -11,45 +11,174 @@
 #ifndef OU3_HASH_TABLE_H
 #define OU3_HASH_TABLE_H
 
+#include "dictionary.h"
 #include "hash.h"
+#include "pdu.h"
+#include "slab.h"
 #include <stdlib.h>
 #include <string.h>
 
+//With RECORD_WIRE set every record keeps its ssn so it is the body of its VAL_INSERT pdu, at the cost of
+//SSN_LENGTH bytes per entry. Otherwise only records of raw keys keep the ssn
+#ifndef RECORD_WIRE
+#define RECORD_WIRE 0
+#endif
+
+#if RECORD_WIRE && RECORD_DICTIONARY
+#error "RECORD_WIRE keeps records as they are sent and cannot be combined with RECORD_DICTIONARY"
+#endif
+
+#define RECORD_SSN_LENGTH(key) (RECORD_WIRE || ((key) & SSN_KEY_RAW) ? SSN_LENGTH : 0)
+
+//With RECORD_DICTIONARY a record ends in a byte that flags the fields the dictionary could not shorten,
+//those are stored as they are
+#define RECORD_FLAGS_LENGTH RECORD_DICTIONARY
+#define RECORD_RAW_NAME 1
+#define RECORD_RAW_EMAIL 2
+
+//With HASH_CONCURRENT set reader threads can call hash_table_lookup_concurrent while one writer thread
+//changes the table. Every change is wrapped in the sequence count of its bucket, or of the table when
+//the range changes, and replaced memory is handed to the epoch reclamation instead of being freed
+#ifndef HASH_CONCURRENT
+#define HASH_CONCURRENT 0
+#endif
+
+#define HASH_TABLE_RECORD_MAX (SSN_LENGTH + 2 + 2 * 255 + RECORD_FLAGS_LENGTH)
+#define HASH_TABLE_BATCH 256
+
 /**
- * A data structure for every hash table entry
+ * A view of a hash table entry. The name and email point into the table and are not null terminated,
+ * they stay valid until the entry is removed or the table is changed. A missing entry has a NULL name.
+ * The fields are the name_length, name, email_length and email bytes of the record, laid out the same
+ * way as in a VAL_INSERT or VAL_LOOKUP_RESPONSE pdu so they can be sent without a copy. When the record
+ * keeps its ssn, see RECORD_WIRE, wire points at the ssn right before the fields, otherwise it is NULL.
+ * With RECORD_DICTIONARY the record is decoded into the entry itself and the views point into decoded,
+ * so such an entry must not be copied
  */
 typedef struct {
-    char* ssn;
-    char* name;
-    char* email;
+    char ssn[SSN_LENGTH];
+    const char *name;
+    const char *email;
+    uint8_t nameLength;
+    uint8_t emailLength;
+    const uint8_t *fields;
+    int fieldsLength;
+    const uint8_t *wire;
+#if RECORD_DICTIONARY
+    uint8_t decoded[2 + 2 * DICTIONARY_FIELD_MAX];
+#endif
 } hash_table_entry;
 
 /**
- * A data structure for a bucket part of the hash table data structure
+ * A record for hash_table_insert_batch, the fields point into memory of the caller
  */
 typedef struct {
-    hash_table_entry **list;
+    const char *ssn;
+    const char *name;
+    const char *email;
+    uint8_t nameLength;
+    uint8_t emailLength;
+} hash_table_record;
+
+/**
+ * A slot in the open addressing table of a bucket. The ssn is stored inline as a packed key so
+ * probing never has to follow the record pointer, an empty slot has a NULL record.
+ *
+ * A record is one allocation from the bucket slab laid out as name_length, name, email_length, email,
+ * with RECORD_DICTIONARY the name and email are encoded, the lengths are those of the encoded bytes and a
+ * byte of RECORD_RAW_NAME and RECORD_RAW_EMAIL flags follows the email.
+ * Records of raw keys, see ssn_pack, and all records when RECORD_WIRE is set start with the 12 ssn characters
+ */
+typedef struct {
+    uint64_t key;
+    uint8_t *record;
+} hash_table_slot;
+
+/**
+ * A data structure for a bucket part of the hash table data structure. Every bucket is a
+ * linear probing table whose capacity is a power of two and doubles when it gets too full.
+ * The records of the bucket are carved from its own slab so a bucket is released in bulk.
+ * The tags hold a fingerprint for every slot and are probed a group at a time. Removed entries leave a
+ * tombstone tag that is dropped when the bucket is rehashed or compacted.
+ * The filter is a bloom filter over the keys so most missing ssns are rejected without probing, it is
+ * rebuilt together with the slots and keeps removed keys until then. The sequence count is odd while the
+ * bucket is being changed, see HASH_CONCURRENT
+ */
+typedef struct {
+    unsigned int seq;
+    hash_table_slot *slots;
+    uint8_t *tags;
+    uint64_t *filter;
+    int filterWords;
+    int capacity;
     int length;
+    int tombstones;
+    int mapped;
+    slab records;
 }bucket;
 
 /**
- * A data structure representing the hash table
+ * A table file mapped into memory. Buckets loaded from the file borrow their slots, tags and records
+ * from the mapping, which is unmapped when the last hash table using it is destroyed
  */
 typedef struct {
-    uint8_t minHash;
-    uint8_t maxHash;
+    void *base;
+    size_t size;
+    int references;
+} hash_table_mapping;
+
+/**
+ * A data structure representing the hash table. There is one bucket for every HASH_BUCKET value in the
+ * range, with a keyspace wider than 8 bits the buckets at the ends can hold hashes outside the range
+ * of a neighbour and entries are split between the tables when such a bucket is cut
+ */
+typedef struct {
+    unsigned int seq;
+    hash_t minHash;
+    hash_t maxHash;
     bucket *buckets;
+    hash_table_mapping *mapping;
+    unsigned long changes;
+    int compactCursor;
+    unsigned long filterRejects;
+    unsigned long filterFalsePositives;
 } hash_table;
 
-hash_table* hash_table_create(uint8_t min, uint8_t max);
-hash_table* hash_table_resize(hash_table *table, uint8_t newMin, uint8_t newMax);
+/**
+ * Memory use and accuracy of the bloom filters of a table. The estimate is the chance that a missing ssn
+ * gets past the filters, the counters are what lookups have seen since the table was created
+ */
+typedef struct {
+    size_t bytes;
+    long entries;
+    double estimatedFalsePositiveRate;
+    unsigned long rejects;
+    unsigned long falsePositives;
+} hash_table_filter_stats;
+
+hash_table* hash_table_create(hash_t min, hash_t max);
+hash_table* hash_table_resize(hash_table *table, hash_t newMin, hash_t newMax);
+hash_table* hash_table_detach_range(hash_table *table, hash_t lo, hash_t hi);
 void hash_table_destroy(hash_table *table);
-int hash_table_insert(hash_table *table, hash_table_entry *entry);
+int hash_table_insert(hash_table *table, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength);
+int hash_table_insert_batch(hash_table *table, const hash_table_record *records, int count, int *statuses);
 int hash_table_remove(hash_table *table, char *ssn);
+void hash_table_bucket_insert(bucket *b, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength);
+int hash_table_bucket_remove(bucket *b, const char *ssn);
 void hash_table_print(hash_table *table);
-bucket  *hash_table_get_buckets_from(hash_table *table, uint8_t min);
-hash_table_entry *hash_table_create_entry(const char *ssn, char *name, char *email);
-int hash_table_get_span(hash_table *table);
-int hash_table_lookup(hash_table *table, char* ssn, hash_table_entry *entry);
+int hash_table_compact(hash_table *table, int budget);
+bucket  *hash_table_get_buckets_from(hash_table *table, int index);
+uint64_t hash_table_get_span(hash_table *table);
+int hash_table_get_bucket_count(hash_table *table);
+int hash_table_bucket_index(hash_table *table, hash_t hash);
+int hash_table_lookup(hash_table *table, const char* ssn, hash_table_entry *entry);
+int hash_table_contains(hash_table *table, const char *ssn, hash_table_entry *entry);
+void hash_table_get_filter_stats(hash_table *table, hash_table_filter_stats *stats);
+#if HASH_CONCURRENT
+int hash_table_lookup_concurrent(hash_table *table, const char *ssn, hash_table_entry *entry, uint8_t record[HASH_TABLE_RECORD_MAX]);
+#endif
+int hash_table_bucket_next(bucket *b, int index, hash_table_entry *entry);
+int hash_table_save(hash_table *table, const char *path);
+hash_table* hash_table_open(const char *path);
 
 #endif //OU3_HASH_TABLE_H
@@ -16,8 +16,8 @@ int main(int argc, char *argv[]) {
 
     states currentState =  Q1;
 
-	if(argc != 3)
-		exit_on_error_custom("Parameters"," <tracker address> <tracker port>");
+	if(argc != 3 && argc != 4)
+		exit_on_error_custom("Parameters"," <tracker address> <tracker port> [data file]");
 	
 	char *trackerIp = (char*)malloc((strlen(argv[1])+1)*sizeof(char));
 	int trackerPort = atoi(argv[2]);
@@ -28,6 +28,12 @@ int main(int argc, char *argv[]) {
 
     node n = {};
 
+    if(argc == 4) {
+        n.dataFile = argv[3];
+        n.logFile = malloc(strlen(argv[3]) + 5);
+        sprintf(n.logFile, "%s.wal", argv[3]);
+    }
+
     n.addr = calloc(1, sizeof(struct sockaddr_in));
     n.predecessor = calloc(1, sizeof(struct sockaddr_in));
     n.predecessor->sin_addr.s_addr = 0;
@@ -51,7 +57,7 @@ int main(int argc, char *argv[]) {
     n.socketBuffers = calloc(4, sizeof(socket_buffer));
 
     for (int i = 0; i < 4; ++i) {
-        n.socketBuffers[i].buffer = calloc(BUFF_SIZE, sizeof(char));
+        socket_buffer_create(&n.socketBuffers[i], BUFF_SIZE);
     }
 
     state* stateMachine = node_states_get_state_machine();
@@ -65,9 +71,27 @@ int main(int argc, char *argv[]) {
     free(n.predecessor);
     free(n.successor);
     free(n.listeningPort);
+
+#if UDP_WORKERS > 0
+    if (n.workers){
+        workers_stop(n.workers);
+    }
+#endif
+
+    if (n.reactor){
+        reactor_destroy(n.reactor);
+    }
+
+#if IO_URING
+    if (n.ring){
+        uring_destroy(n.ring);
+    }
+#endif
+
+    //The ring still delivers into the buffers while it flushes, so they go after it
     free(n.sockets);
     for (int i = 0; i < 4; ++i) {
-        free(n.socketBuffers[i].buffer);
+        socket_buffer_destroy(&n.socketBuffers[i]);
     }
     free(n.socketBuffers);
 
@@ -75,6 +99,15 @@ int main(int argc, char *argv[]) {
         hash_table_destroy(n.table);
     }
 
+    if (n.log){
+        wal_close(n.log);
+    }
+
+    if (n.index){
+        ssn_index_destroy(n.index);
+    }
+    free(n.logFile);
+
     if(n.lastPdu) {
         free(n.lastPdu);
     }
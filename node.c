@@ -17,6 +17,7 @@
 
 static void serialize_uint32(char bytes[], uint32_t s);
 static void serialize_uint16(char bytes[], uint16_t s);
+static void serialize_uint64(char bytes[], uint64_t s);
 static void serialize_string(char *bytes, char* s, int len);
 
 /**
@@ -131,6 +132,13 @@ int parse_net_join_response(int type, const char *pdu, struct NET_JOIN_RESPONSE_
     resp->type = type;
     resp->next_address = *(uint32_t*)(pdu+1);
     resp->next_port = *(uint16_t*)(pdu+5);
+
+    if(type == NET_JOIN_RESPONSE_WIDE) {
+        resp->range_start = *(uint64_t*)(pdu+7);
+        resp->range_end = *(uint64_t*)(pdu+15);
+        return NET_JOIN_RESPONSE_WIDE_BASE_LENGTH;
+    }
+
     resp->range_start = *(uint8_t*)(pdu+7);
     resp->range_end = *(uint8_t*)(pdu+8);
     return NET_JOIN_RESPONSE_BASE_LENGTH;
@@ -147,6 +155,15 @@ int parse_net_join(int type, const char *pdu, struct NET_JOIN_PDU *resp) {
     resp->type = type;
     resp->src_address = *(uint32_t*)(pdu+1);
     resp->src_port = *(uint16_t*)(pdu+5);
+
+    if(type == NET_JOIN_WIDE) {
+        resp->max_span = *(uint64_t*)(pdu+7);
+        resp->max_address = *(uint32_t *)(pdu+15);
+        resp->max_port = *(uint16_t *)(pdu+19);
+
+        return NET_JOIN_WIDE_BASE_LENGTH;
+    }
+
     resp->max_span = *(uint8_t*)(pdu+7);
     resp->max_address = *(uint32_t *)(pdu+8);
     resp->max_port = *(uint16_t *)(pdu+12);
@@ -177,6 +194,14 @@ int parse_net_leaving(int type, const char *pdu, struct NET_LEAVING_PDU *resp) {
  */
 int parse_net_new_range(int type, const char *pdu, struct NET_NEW_RANGE_PDU *resp) {
     resp->type = type;
+
+    if(type == NET_NEW_RANGE_WIDE) {
+        resp->range_start = *(uint64_t*)(pdu+1);
+        resp->range_end = *(uint64_t*)(pdu+9);
+
+        return NET_NEW_RANGE_WIDE_BASE_LENGTH;
+    }
+
     resp->range_start = *(uint8_t*)(pdu+1);
     resp->range_end = *(uint8_t*)(pdu+2);
 
@@ -275,19 +300,165 @@ int parse_val_insert_pdu(int type, const char *pdu, struct VAL_INSERT_PDU *resp)
     return offset;
 }
 
+/**
+ * Parses a byte array representing the VAL_INSERT_BATCH_PDU data structure, the records are copied
+ * into one allocation that the caller frees
+ * @param type
+ * @param pdu
+ * @param resp
+ * @return the length of the packet
+ */
+int parse_val_insert_batch_pdu(int type, const char *pdu, struct VAL_INSERT_BATCH_PDU *resp) {
+    resp->type = type;
+    resp->length = *(uint16_t*)(pdu + 1);
+    resp->count = *(uint16_t*)(pdu + 3);
+
+    //The caller sizes its record arrays by count, so it is never more than the shortest records can fill
+    int fits = (resp->length - VAL_INSERT_BATCH_BASE_LENGTH) / (VAL_INSERT_BASE_LENGTH - 1);
+
+    if(resp->count > fits) {
+        resp->count = fits;
+    }
+
+    resp->records = malloc(resp->length - VAL_INSERT_BATCH_BASE_LENGTH + 1);
+
+    if(!resp->records) {
+        perror("resp->records || malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(resp->records, pdu + VAL_INSERT_BATCH_BASE_LENGTH, resp->length - VAL_INSERT_BATCH_BASE_LENGTH);
+
+    return resp->length;
+}
+
+/**
+ * Points a table record at every record of a VAL_INSERT_BATCH_PDU. Parsing stops at the first record
+ * that does not fit in the pdu
+ * @param pdu
+ * @param records room for pdu->count records
+ * @return the number of records
+ */
+int parse_val_insert_batch_records(const struct VAL_INSERT_BATCH_PDU *pdu, hash_table_record *records) {
+    const char *bytes = (const char*)pdu->records;
+    int len = pdu->length - VAL_INSERT_BATCH_BASE_LENGTH;
+    int offset = 0;
+    int count = 0;
+
+    while(count < pdu->count && offset + VAL_INSERT_BASE_LENGTH - 1 <= len) {
+        hash_table_record *record = &records[count];
+
+        record->ssn = bytes + offset;
+        record->nameLength = (uint8_t)bytes[offset + SSN_LENGTH];
+        record->name = bytes + offset + SSN_LENGTH + 1;
+
+        if(offset + VAL_INSERT_BASE_LENGTH - 1 + record->nameLength > len) {
+            break;
+        }
+
+        record->emailLength = (uint8_t)bytes[offset + SSN_LENGTH + 1 + record->nameLength];
+        record->email = record->name + record->nameLength + 1;
+
+        if(offset + VAL_INSERT_BASE_LENGTH - 1 + record->nameLength + record->emailLength > len) {
+            break;
+        }
+
+        offset += VAL_INSERT_BASE_LENGTH - 1 + record->nameLength + record->emailLength;
+        count += 1;
+    }
+
+    return count;
+}
+
+/**
+ * Parses a byte array representing the VAL_LOOKUP_BATCH_PDU data structure, the ssns are copied into
+ * one allocation that the caller frees. A count that does not fit in the length is cut down
+ * @param type
+ * @param pdu
+ * @param resp
+ * @return the length of the packet
+ */
+int parse_val_lookup_batch_pdu(int type, const char *pdu, struct VAL_LOOKUP_BATCH_PDU *resp) {
+    resp->type = type;
+    resp->length = *(uint16_t*)(pdu + 1);
+    resp->count = *(uint16_t*)(pdu + 3);
+    resp->sender_address = *(uint32_t*)(pdu + 5);
+    resp->sender_port = *(uint16_t*)(pdu + 9);
+
+    int fits = (resp->length - VAL_LOOKUP_BATCH_BASE_LENGTH) / SSN_LENGTH;
+
+    if(resp->count > fits) {
+        resp->count = fits;
+    }
+
+    resp->ssns = malloc(resp->count * SSN_LENGTH + 1);
+
+    if(!resp->ssns) {
+        perror("resp->ssns || malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(resp->ssns, pdu + VAL_LOOKUP_BATCH_BASE_LENGTH, resp->count * SSN_LENGTH);
+
+    return resp->length;
+}
+
+/**
+ * Parses a byte array representing the VAL_SCAN_PDU data structure
+ * @param type
+ * @param bytes
+ * @param resp
+ * @return the length of the packet
+ */
+int parse_val_scan_pdu(int type, const char *pdu, struct VAL_SCAN_PDU *resp) {
+    resp->type = type;
+    int offset = 1;
+
+    resp->prefix_length = *(uint8_t*)(pdu+offset);
+    offset += 1;
+
+    for(int i = 0; i < SSN_LENGTH; i++){
+        resp->prefix[i] = pdu[offset + i];
+    }
+    offset += SSN_LENGTH;
+
+    resp->sender_address = *(uint32_t*)(pdu+offset);
+    offset += 4;
+
+    resp->sender_port = *(uint16_t*)(pdu+offset);
+    offset += 2;
+
+    resp->forwarded = *(uint8_t*)(pdu+offset);
+    offset += 1;
+
+    resp->stop_hash = *(uint64_t*)(pdu+offset);
+    offset += 8;
+
+    return offset;
+}
+
 /**
  * Serializes the data structure NET_JOIN_PDU into a byte array
  *
  * @param bytes
  * @param s
  */
-void serialize_net_join_pdu(char bytes[], struct NET_JOIN_PDU s) {
+int serialize_net_join_pdu(char bytes[], struct NET_JOIN_PDU s) {
     bytes[0] = s.type;
     serialize_uint32(bytes+1, s.src_address);
     serialize_uint16(bytes+5, s.src_port);
+
+    if(s.type == NET_JOIN_WIDE) {
+        serialize_uint64(bytes+7, s.max_span);
+        serialize_uint32(bytes+15, s.max_address);
+        serialize_uint16(bytes+19, s.max_port);
+        return NET_JOIN_WIDE_BASE_LENGTH;
+    }
+
     bytes[7] = s.max_span;
     serialize_uint32(bytes+8, s.max_address);
     serialize_uint16(bytes+12, s.max_port);
+    return NET_JOIN_BASE_LENGTH;
 }
 
 /**
@@ -296,12 +467,20 @@ void serialize_net_join_pdu(char bytes[], struct NET_JOIN_PDU s) {
  * @param bytes
  * @param s
  */
-void serialize_net_join_response_pdu(char bytes[], struct NET_JOIN_RESPONSE_PDU s) {
+int serialize_net_join_response_pdu(char bytes[], struct NET_JOIN_RESPONSE_PDU s) {
     bytes[0] = s.type;
     serialize_uint32(bytes+1, s.next_address);
     serialize_uint16(bytes+5, s.next_port);
+
+    if(s.type == NET_JOIN_RESPONSE_WIDE) {
+        serialize_uint64(bytes+7, s.range_start);
+        serialize_uint64(bytes+15, s.range_end);
+        return NET_JOIN_RESPONSE_WIDE_BASE_LENGTH;
+    }
+
     bytes[7] = s.range_start;
     bytes[8] = s.range_end;
+    return NET_JOIN_RESPONSE_BASE_LENGTH;
 }
 
 /**
@@ -389,6 +568,41 @@ int serialize_val_lookup_response_pdu(char bytes[], struct VAL_LOOKUP_RESPONSE_P
     return offset;
 }
 
+/**
+ * Describes the VAL_LOOKUP_RESPONSE_PDU for a table entry as two iovecs for sendmsg. Only the type and ssn
+ * are written to header, the name and email are sent straight from the table record, and so is the ssn
+ * when the record keeps it. A missing entry is answered with a zero ssn and empty name and email
+ *
+ * @param header VAL_LOOKUP_RESPONSE_HEADER_LENGTH bytes
+ * @param iov
+ * @param entry
+ * @return the length of the pdu
+ */
+int serialize_val_lookup_response_iov(char header[], struct iovec iov[2], const hash_table_entry *entry) {
+    static const uint8_t empty[2] = {0, 0};
+
+    header[0] = VAL_LOOKUP_RESPONSE;
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = VAL_LOOKUP_RESPONSE_HEADER_LENGTH;
+
+    if(entry->wire) {
+        iov[0].iov_len = 1;
+        iov[1].iov_base = (void*)entry->wire;
+        iov[1].iov_len = SSN_LENGTH + entry->fieldsLength;
+    } else if(entry->name != NULL) {
+        memcpy(header + 1, entry->ssn, SSN_LENGTH);
+        iov[1].iov_base = (void*)entry->fields;
+        iov[1].iov_len = entry->fieldsLength;
+    } else {
+        memset(header + 1, 0, SSN_LENGTH);
+        iov[1].iov_base = (void*)empty;
+        iov[1].iov_len = sizeof(empty);
+    }
+
+    return VAL_LOOKUP_RESPONSE_HEADER_LENGTH + (int)iov[1].iov_len;
+}
+
 /**
  * Serializes the data structure NET_LEAVING_PDU into a byte array
  *
@@ -410,9 +624,163 @@ int serialize_net_leaving_pdu(char bytes[], struct NET_LEAVING_PDU s) {
  */
 int serialize_net_new_range_pdu(char bytes[], struct NET_NEW_RANGE_PDU s){
     bytes[0] = s.type;
+
+    if(s.type == NET_NEW_RANGE_WIDE) {
+        serialize_uint64(bytes + 1, s.range_start);
+        serialize_uint64(bytes + 9, s.range_end);
+        return NET_NEW_RANGE_WIDE_BASE_LENGTH;
+    }
+
     bytes[1] = s.range_start;
     bytes[2] = s.range_end;
-    return 3;
+    return NET_NEW_RANGE_BASE_LENGTH;
+}
+
+/**
+ * Serializes the data structure VAL_SCAN_PDU into a byte array
+ *
+ * @param bytes
+ * @param s
+ */
+int serialize_val_scan_pdu(char bytes[], struct VAL_SCAN_PDU s) {
+    bytes[0] = s.type;
+    bytes[1] = s.prefix_length;
+    serialize_string(bytes + 2, (char*)s.prefix, SSN_LENGTH);
+    serialize_uint32(bytes + SSN_LENGTH + 2, s.sender_address);
+    serialize_uint16(bytes + SSN_LENGTH + 6, s.sender_port);
+    bytes[SSN_LENGTH + 8] = s.forwarded;
+    serialize_uint64(bytes + SSN_LENGTH + 9, s.stop_hash);
+    return VAL_SCAN_BASE_LENGTH;
+}
+
+/**
+ * Serializes the header of the data structure VAL_SCAN_RESPONSE_PDU into a byte array
+ *
+ * @param bytes
+ * @param s
+ */
+int serialize_val_scan_response_pdu(char bytes[], struct VAL_SCAN_RESPONSE_PDU s) {
+    bytes[0] = s.type;
+    serialize_uint64(bytes + 1, s.range_start);
+    serialize_uint64(bytes + 9, s.range_end);
+    bytes[17] = s.last_page;
+    bytes[18] = s.count;
+    return VAL_SCAN_RESPONSE_BASE_LENGTH;
+}
+
+/**
+ * Serializes the header of the data structure VAL_INSERT_BATCH_PDU into a byte array
+ *
+ * @param bytes
+ * @param s
+ */
+int serialize_val_insert_batch_pdu(char bytes[], struct VAL_INSERT_BATCH_PDU s) {
+    bytes[0] = s.type;
+    serialize_uint16(bytes + 1, s.length);
+    serialize_uint16(bytes + 3, s.count);
+    return VAL_INSERT_BATCH_BASE_LENGTH;
+}
+
+/**
+ * Serializes a record of a VAL_INSERT_BATCH_PDU into a byte array
+ *
+ * @param bytes
+ * @param record
+ * @return the length of the record
+ */
+int serialize_val_insert_batch_record(char bytes[], const hash_table_record *record) {
+    int len = VAL_INSERT_BASE_LENGTH - 1 + record->nameLength + record->emailLength;
+
+    memcpy(bytes, record->ssn, SSN_LENGTH);
+    bytes[SSN_LENGTH] = record->nameLength;
+    memcpy(bytes + SSN_LENGTH + 1, record->name, record->nameLength);
+    bytes[SSN_LENGTH + 1 + record->nameLength] = record->emailLength;
+    memcpy(bytes + SSN_LENGTH + 2 + record->nameLength, record->email, record->emailLength);
+
+    return len;
+}
+
+/**
+ * Serializes the data structure VAL_LOOKUP_BATCH_PDU and its ssns into a byte array
+ *
+ * @param bytes
+ * @param s
+ * @return the length of the pdu
+ */
+int serialize_val_lookup_batch_pdu(char bytes[], struct VAL_LOOKUP_BATCH_PDU s) {
+    bytes[0] = s.type;
+    serialize_uint16(bytes + 1, VAL_LOOKUP_BATCH_BASE_LENGTH + s.count * SSN_LENGTH);
+    serialize_uint16(bytes + 3, s.count);
+    serialize_uint32(bytes + 5, s.sender_address);
+    serialize_uint16(bytes + 9, s.sender_port);
+    memcpy(bytes + VAL_LOOKUP_BATCH_BASE_LENGTH, s.ssns, s.count * SSN_LENGTH);
+    return VAL_LOOKUP_BATCH_BASE_LENGTH + s.count * SSN_LENGTH;
+}
+
+/**
+ * Serializes the header of the data structure VAL_LOOKUP_BATCH_RESPONSE_PDU into a byte array
+ *
+ * @param bytes
+ * @param s
+ */
+int serialize_val_lookup_batch_response_pdu(char bytes[], struct VAL_LOOKUP_BATCH_RESPONSE_PDU s) {
+    bytes[0] = s.type;
+    serialize_uint16(bytes + 1, s.length);
+    serialize_uint16(bytes + 3, s.count);
+    return VAL_LOOKUP_BATCH_RESPONSE_BASE_LENGTH;
+}
+
+/**
+ * Serializes one entry of a VAL_LOOKUP_BATCH_RESPONSE_PDU into a byte array
+ *
+ * @param bytes
+ * @param ssn
+ * @param entry the entry of ssn, a NULL name means it is missing
+ * @return the length of the entry
+ */
+int serialize_val_lookup_batch_entry(char bytes[], const uint8_t *ssn, const hash_table_entry *entry) {
+    if(entry->name == NULL) {
+        bytes[0] = 0;
+        memcpy(bytes + 1, ssn, SSN_LENGTH);
+        bytes[SSN_LENGTH + 1] = 0;
+        bytes[SSN_LENGTH + 2] = 0;
+        return SSN_LENGTH + 3;
+    }
+
+    bytes[0] = 1;
+
+    return 1 + serialize_val_scan_entry(bytes + 1, entry);
+}
+
+/**
+ * Serializes one entry of a VAL_SCAN_RESPONSE_PDU into a byte array
+ *
+ * @param bytes
+ * @param entry
+ * @return the length of the entry
+ */
+int serialize_val_scan_entry(char bytes[], const hash_table_entry *entry) {
+    if(entry->wire) {
+        memcpy(bytes, entry->wire, SSN_LENGTH + entry->fieldsLength);
+    } else {
+        memcpy(bytes, entry->ssn, SSN_LENGTH);
+        memcpy(bytes + SSN_LENGTH, entry->fields, entry->fieldsLength);
+    }
+
+    return SSN_LENGTH + entry->fieldsLength;
+}
+
+/**
+ * Serializes a table entry as a VAL_INSERT_PDU into a byte array, the record is copied as it is
+ *
+ * @param bytes
+ * @param entry
+ * @return the length of the pdu
+ */
+int serialize_val_insert_entry(char bytes[], const hash_table_entry *entry) {
+    bytes[0] = VAL_INSERT;
+
+    return 1 + serialize_val_scan_entry(bytes + 1, entry);
 }
 
 /**
@@ -449,4 +817,14 @@ static void serialize_uint32(char bytes[], uint32_t s) {
 static void serialize_uint16(char bytes[], uint16_t s) {
     bytes[0] = s & 0xFF;
     bytes[1] = (s >> 8) & 0xFF;
-}
\ No newline at end of file
+}
+
+/**
+ * Serializes a uint64
+ * @param bytes
+ * @param s
+ */
+static void serialize_uint64(char bytes[], uint64_t s) {
+    serialize_uint32(bytes, (uint32_t)s);
+    serialize_uint32(bytes + 4, (uint32_t)(s >> 32));
+}
@@ -12,16 +12,15 @@
 #define OU3_NODE_H
 #include <stdint.h>
 #include <netinet/in.h>
+#include <sys/uio.h>
 #include <pdu.h>
 #include "hash_table.h"
-
-/**
- * The data structure for the socket buffer
- */
-typedef struct {
-    char *buffer;
-    int len;
-} socket_buffer;
+#include "wal.h"
+#include "ssn_index.h"
+#include "workers.h"
+#include "reactor.h"
+#include "uring.h"
+#include "socket_buffer.h"
 
 /**
  * The data structure for the node
@@ -37,6 +36,15 @@ typedef struct {
     void *lastPdu;
     socket_buffer *socketBuffers;
     time_t lastAlive;
+    char *dataFile;
+    char *logFile;
+    wal *log;
+    ssn_index *index;
+    udp_workers *workers;
+    reactor *reactor;
+    uring *ring;
+    unsigned long savedChanges;
+    time_t lastSave;
 } node;
 
 int create_socket(int type);
@@ -51,14 +59,28 @@ int parse_net_new_range(int type, const char *pdu, struct NET_NEW_RANGE_PDU *res
 int parse_val_lookup_pdu(int type, const char *pdu, struct VAL_LOOKUP_PDU *resp);
 int parse_val_remove_pdu(int type, const char *pdu, struct VAL_REMOVE_PDU *resp);
 int parse_val_insert_pdu(int type, const char *pdu, struct VAL_INSERT_PDU *resp);
-void serialize_net_join_pdu(char bytes[], struct NET_JOIN_PDU s);
-void serialize_net_join_response_pdu(char bytes[], struct NET_JOIN_RESPONSE_PDU s);
+int parse_val_scan_pdu(int type, const char *pdu, struct VAL_SCAN_PDU *resp);
+int parse_val_insert_batch_pdu(int type, const char *pdu, struct VAL_INSERT_BATCH_PDU *resp);
+int parse_val_insert_batch_records(const struct VAL_INSERT_BATCH_PDU *pdu, hash_table_record *records);
+int parse_val_lookup_batch_pdu(int type, const char *pdu, struct VAL_LOOKUP_BATCH_PDU *resp);
+int serialize_net_join_pdu(char bytes[], struct NET_JOIN_PDU s);
+int serialize_net_join_response_pdu(char bytes[], struct NET_JOIN_RESPONSE_PDU s);
 int serialize_val_insert_pdu(char bytes[], struct VAL_INSERT_PDU s);
 int serialize_val_lookup_response_pdu(char bytes[], struct VAL_LOOKUP_RESPONSE_PDU s);
+int serialize_val_lookup_response_iov(char header[], struct iovec iov[2], const hash_table_entry *entry);
 int serialize_net_leaving_pdu(char bytes[], struct NET_LEAVING_PDU s);
 void serialize_val_lookup_pdu(char bytes[], struct  VAL_LOOKUP_PDU s);
 void serialize_val_remove_pdu(char bytes[], struct  VAL_REMOVE_PDU s);
 int serialize_net_new_range_pdu(char bytes[], struct NET_NEW_RANGE_PDU s);
+int serialize_val_scan_pdu(char bytes[], struct VAL_SCAN_PDU s);
+int serialize_val_scan_response_pdu(char bytes[], struct VAL_SCAN_RESPONSE_PDU s);
+int serialize_val_scan_entry(char bytes[], const hash_table_entry *entry);
+int serialize_val_insert_entry(char bytes[], const hash_table_entry *entry);
+int serialize_val_insert_batch_pdu(char bytes[], struct VAL_INSERT_BATCH_PDU s);
+int serialize_val_insert_batch_record(char bytes[], const hash_table_record *record);
+int serialize_val_lookup_batch_pdu(char bytes[], struct VAL_LOOKUP_BATCH_PDU s);
+int serialize_val_lookup_batch_response_pdu(char bytes[], struct VAL_LOOKUP_BATCH_RESPONSE_PDU s);
+int serialize_val_lookup_batch_entry(char bytes[], const uint8_t *ssn, const hash_table_entry *entry);
 int listen_socket(int fd);
 
 #endif
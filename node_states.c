@@ -12,6 +12,7 @@
 #include "node_states.h"
 #include <arpa/inet.h>
 #include "hash_table.h"
+#include "epoch.h"
 #include <signal.h>
 
 static states Q1_handler(node *args);
@@ -32,13 +33,29 @@ static states Q15_handler(node *args);
 static states Q16_handler(node *args);
 static states Q17_handler(node *args);
 static states Q18_handler(node *args);
-static int read_pdu_type(struct pollfd *fd, int expectedType, socket_buffer *pdu, int protocol);
+static int read_pdu_type(node *args, struct pollfd *fd, int expectedType, socket_buffer *pdu, int protocol);
+#if !IO_URING
 static void read_udp_pdu(struct pollfd *fd, socket_buffer *buff, int timeout);
 static void read_pdu(struct pollfd* fd, socket_buffer *buff, int len, int timeout);
+#endif
+static int receive_datagrams(int fd, void *context);
+static int receive_stream(int fd, void *context);
+static void watch_sockets(node *args);
+static void forget_socket(node *args, int fd);
+static void send_stream(node *args, int fd, const void *bytes, int len);
+static void send_datagram(node *args, const struct iovec *iov, int count, const struct sockaddr_in *addr);
+static void flush_sends(node *args);
+static states parse_pdu(node *args, int i);
 static void accept_predacessor(node *args);
 static void save_last_pdu(node *n, void *pdu);
 static void clear_buffer(socket_buffer *buffer, int bytes);
-static void transfer_entry_range(node *args, int fd, int rangeMin);
+static void transfer_entry_range(node *args, int fd, hash_t rangeMin);
+static void send_entry_range(hash_table *range, int fd);
+static void print_filter_stats(hash_table *table);
+static hash_table *open_table(node *args, hash_t min, hash_t max);
+static void save_table(node *args);
+static void send_scan_pages(node *args, struct VAL_SCAN_PDU *pdu);
+static void answer_lookup_batch(node *args, struct VAL_LOOKUP_BATCH_PDU *pdu);
 
 state stateMachine[] = {
         {Q1_handler},
@@ -62,6 +79,8 @@ state stateMachine[] = {
 };
 
 static int shouldClose = 0;
+static int idlePass = 0;
+static time_t lastCompact = 0;
 
 state* node_states_get_state_machine() {
     return stateMachine;
@@ -86,6 +105,10 @@ static states Q1_handler(node *args){
     printf("    Create sockets\n");
     args->sockets[0].fd  = create_socket(SOCK_DGRAM);
 
+#if UDP_WORKERS > 0
+    workers_prepare_socket(args->sockets[0].fd);
+#endif
+
     struct STUN_LOOKUP_PDU pkt = {STUN_LOOKUP};
 
     printf("Send STUN_LOOKUP to tracker\n");
@@ -118,7 +141,7 @@ static states Q1_handler(node *args){
  */
 static states Q2_handler(node *args){
     printf("[Q2]\n");
-    int type = read_pdu_type(&args->sockets[0], STUN_RESPONSE, &args->socketBuffers[0], UDP);
+    int type = read_pdu_type(args, &args->sockets[0], STUN_RESPONSE, &args->socketBuffers[0], UDP);
 
     struct STUN_RESPONSE_PDU *resp = malloc(sizeof(*resp));
     int len = parse_stun_response(type, args->socketBuffers[0].buffer, resp);
@@ -149,7 +172,7 @@ static states Q3_handler(node *args){
 
     sendto(args->sockets[0].fd, &u, sizeof(u), 0, (struct sockaddr*)&args->tracker, sizeof(args->tracker));
 
-    int type = read_pdu_type(&args->sockets[0], NET_GET_NODE_RESPONSE, &args->socketBuffers[0], UDP);
+    int type = read_pdu_type(args, &args->sockets[0], NET_GET_NODE_RESPONSE, &args->socketBuffers[0], UDP);
     struct NET_GET_NODE_RESPONSE_PDU *response = malloc(sizeof(*response));
     int len = parse_get_node_response(type, args->socketBuffers[0].buffer, response);
 
@@ -175,7 +198,7 @@ static states Q4_handler(node *args) {
 
     printf("    Initilize table to network size\n");
 
-    args->table = hash_table_create(0, 255);
+    args->table = open_table(args, 0, HASH_MAX);
 
     return Q6;
 }
@@ -200,20 +223,22 @@ static states Q5_handler(node *args) {
 
     connect_socket(args->sockets[1].fd, *args->successor);
 
+    hash_t min = args->table->minHash + (args->table->maxHash - args->table->minHash)/2;
+
     //Send NET_JOIN_RESPONSE
     struct NET_JOIN_RESPONSE_PDU package = {
-        NET_JOIN_RESPONSE,
+        JOIN_RESPONSE_TYPE,
         args->addr->sin_addr.s_addr,
         *args->listeningPort,
-        args->table->minHash + args->table->maxHash/2,
+        min,
         args->table->maxHash
     };
 
-    char buff[NET_JOIN_RESPONSE_BASE_LENGTH];
+    char buff[NET_JOIN_RESPONSE_WIDE_BASE_LENGTH];
 
-    serialize_net_join_response_pdu(buff, package);
+    int len = serialize_net_join_response_pdu(buff, package);
 
-    ssize_t status = send(args->sockets[1].fd, buff, NET_JOIN_RESPONSE_BASE_LENGTH, 0);
+    ssize_t status = send(args->sockets[1].fd, buff, len, 0);
 
     if (status < 0){
         perror("Sending NET_JOIN_RESPONSE");
@@ -221,7 +246,7 @@ static states Q5_handler(node *args) {
     }
 
     //Transfer upper half of entry range to successor
-    transfer_entry_range(args, args->sockets[1].fd, args->table->maxHash/2);
+    transfer_entry_range(args, args->sockets[1].fd, min);
 
     //Accept predacessor
     printf("    Accept predacessor\n");
@@ -234,13 +259,18 @@ static states Q5_handler(node *args) {
  * Handles the state Q6 which is the main loop of the program, handles multiple states
  *
  * @param args
- * @returns Q6, Q9, Q10, Q12, Q15, Q16, Q17
+ * @returns Q6, Q10, Q12, Q15, Q16, Q17
  */
 static states Q6_handler(node *args) {
     printf("[Q6]\n");
 
     time_t currentTime = time(NULL);
 
+    //Group commit of every mutation applied since the last iteration
+    if(args->log) {
+        wal_commit(args->log);
+    }
+
     if(currentTime - args->lastAlive > 5){
         struct NET_ALIVE_PDU pkt = {NET_ALIVE};
 
@@ -254,16 +284,83 @@ static states Q6_handler(node *args) {
         args->lastAlive = currentTime;
     }
 
-    read_udp_pdu(&args->sockets[0], &args->socketBuffers[0], 500);
-    read_pdu(args->sockets + 1, args->socketBuffers + 1, 3, 500);
+    if(currentTime - args->lastSave > SAVE_INTERVAL || (args->log && args->log->records >= WAL_SNAPSHOT_RECORDS)) {
+        save_table(args);
+        args->lastSave = currentTime;
+    }
 
-    for(int i = 0; i < 4; i++) {
-        char *buff = args->socketBuffers[i].buffer;
-        int len = args->socketBuffers[i].len;
+#if UDP_WORKERS > 0
+    if(!args->workers) {
+        args->workers = workers_start(args->sockets[0].fd, &args->table, UDP_WORKERS);
+    }
+#endif
+    watch_sockets(args);
+
+    //A pass that handled a PDU can leave more complete PDUs in the buffers, only an idle pass blocks.
+    //The timer of the reactor still wakes an idle node for NET_ALIVE, saving and compaction
+#if IO_URING
+    uring_wait(args->ring, idlePass ? -1 : 0);
+#else
+    reactor_wait(args->reactor, idlePass ? -1 : 0);
+    reactor_dispatch(args->reactor);
+#endif
+    idlePass = 0;
+
+    //Every complete PDU in the buffers is handled before the next wait, DISPATCH_BUDGET at a time from each
+    //socket so a neighbour that floods one socket does not hold back the others
+    int handled;
+    int handledPass = 0;
 
-        if(len == 0){
-            continue;
+    do {
+        handled = 0;
+
+        for(int i = 0; i < 4; i++) {
+            for(int n = 0; n < DISPATCH_BUDGET; n++) {
+                states next = parse_pdu(args, i);
+
+                if(next == Q6) {
+                    break;
+                }
+
+                if(next != Q9) {
+                    return next;
+                }
+
+                Q9_handler(args);
+                handled++;
+            }
         }
+        handledPass += handled;
+    } while(handled > 0);
+
+    //The buffers hold no complete PDU now, so the next wait can block
+    idlePass = 1;
+
+    //Tombstones are dropped when the pass found no PDU, and once a second on a node that is never idle
+    if(args->table && (handledPass == 0 || currentTime != lastCompact)) {
+        hash_table_compact(args->table, COMPACT_BUDGET);
+        lastCompact = currentTime;
+    }
+
+    if(shouldClose == 1) {
+        return Q10;
+    }
+
+    return Q6;
+}
+
+/**
+ * Parses the PDU at the start of a socket buffer and saves it as the last PDU, bytes that start no known
+ * PDU are dropped
+ *
+ * @param args
+ * @param i the socket buffer
+ * @returns the state that handles the PDU, Q6 if the buffer holds no complete PDU
+ */
+static states parse_pdu(node *args, int i) {
+    while(args->socketBuffers[i].len > 0) {
+        char *buff = args->socketBuffers[i].buffer;
+        int len = args->socketBuffers[i].len;
 
         int type = parse_pdu_type(buff);
 
@@ -289,6 +386,36 @@ static states Q6_handler(node *args) {
                     }
                 }
                 break;
+            case VAL_INSERT_BATCH:
+            case VAL_LOOKUP_BATCH:
+                if(len >= VAL_INSERT_BATCH_BASE_LENGTH) {
+                    int packetLen = *(uint16_t*)(buff + 1);
+                    int minLength = type == VAL_INSERT_BATCH ? VAL_INSERT_BATCH_BASE_LENGTH : VAL_LOOKUP_BATCH_BASE_LENGTH;
+                    int maxLength = type == VAL_INSERT_BATCH ? VAL_INSERT_BATCH_MAX_LENGTH : VAL_LOOKUP_BATCH_MAX_LENGTH;
+
+                    if(packetLen < minLength || packetLen > maxLength) {
+                        printf("    Batch pdu %d with length %d\n", type, packetLen);
+                        clear_buffer(&args->socketBuffers[i], 1);
+                        break;
+                    }
+
+                    if(len >= packetLen) {
+                        if(type == VAL_INSERT_BATCH) {
+                            struct VAL_INSERT_BATCH_PDU *resp = malloc(sizeof(*resp));
+                            parse_val_insert_batch_pdu(type, args->socketBuffers[i].buffer, resp);
+                            save_last_pdu(args, resp);
+                        } else {
+                            struct VAL_LOOKUP_BATCH_PDU *resp = malloc(sizeof(*resp));
+                            parse_val_lookup_batch_pdu(type, args->socketBuffers[i].buffer, resp);
+                            save_last_pdu(args, resp);
+                        }
+
+                        clear_buffer(&args->socketBuffers[i], packetLen);
+
+                        return Q9;
+                    }
+                }
+                break;
             case VAL_REMOVE:
                 if(len >= VAL_REMOVE_BASE_LENGTH) {
                     struct VAL_REMOVE_PDU *resp = malloc(VAL_REMOVE_BASE_LENGTH);
@@ -315,12 +442,25 @@ static states Q6_handler(node *args) {
                     return Q9;
                 }
                 break;
+            case VAL_SCAN:
+                if(len >= VAL_SCAN_BASE_LENGTH) {
+                    struct VAL_SCAN_PDU *resp = malloc(sizeof(*resp));
+                    parse_val_scan_pdu(type, args->socketBuffers[i].buffer, resp);
+
+                    clear_buffer(&args->socketBuffers[i], VAL_SCAN_BASE_LENGTH);
+
+                    save_last_pdu(args, resp);
+
+                    return Q9;
+                }
+                break;
             case NET_NEW_RANGE:
-                if(len >= NET_NEW_RANGE_BASE_LENGTH) {
-                    struct NET_NEW_RANGE_PDU *resp = malloc(NET_NEW_RANGE_BASE_LENGTH);
-                    parse_net_new_range(type, args->socketBuffers[i].buffer, resp);
+            case NET_NEW_RANGE_WIDE:
+                if(len >= (type == NET_NEW_RANGE ? NET_NEW_RANGE_BASE_LENGTH : NET_NEW_RANGE_WIDE_BASE_LENGTH)) {
+                    struct NET_NEW_RANGE_PDU *resp = malloc(sizeof(*resp));
+                    int packetLen = parse_net_new_range(type, args->socketBuffers[i].buffer, resp);
 
-                    clear_buffer(&args->socketBuffers[i], NET_NEW_RANGE_BASE_LENGTH);
+                    clear_buffer(&args->socketBuffers[i], packetLen);
 
                     save_last_pdu(args, resp);
 
@@ -348,7 +488,8 @@ static states Q6_handler(node *args) {
                 break;
 
             case NET_JOIN:
-                if (len >= NET_JOIN_BASE_LENGTH){
+            case NET_JOIN_WIDE:
+                if (len >= (type == NET_JOIN ? NET_JOIN_BASE_LENGTH : NET_JOIN_WIDE_BASE_LENGTH)){
                     struct NET_JOIN_PDU *response = malloc(sizeof(*response));
                     int packetLen = parse_net_join(type, args->socketBuffers[i].buffer, response);
 
@@ -365,10 +506,10 @@ static states Q6_handler(node *args) {
                 break;
         }
 
-    }
-
-    if(shouldClose == 1) {
-        return Q10;
+        //Nothing was taken from the buffer, the PDU at its start is not complete yet
+        if(args->socketBuffers[i].len == len) {
+            break;
+        }
     }
 
     return Q6;
@@ -386,7 +527,7 @@ static states Q7_handler(node *args){
     struct NET_GET_NODE_RESPONSE_PDU *response = args->lastPdu;
 
     struct NET_JOIN_PDU pkt = {
-            NET_JOIN,
+            JOIN_TYPE,
             response->address,
             *args->listeningPort,
             0,
@@ -399,13 +540,13 @@ static states Q7_handler(node *args){
     add.sin_addr.s_addr = response->address;
     add.sin_port = response->port;
 
-    char bytes[14];
+    char bytes[NET_JOIN_WIDE_BASE_LENGTH];
 
-    serialize_net_join_pdu(bytes, pkt);
+    int len = serialize_net_join_pdu(bytes, pkt);
 
     printf("    Send NET_JOIN to node in NET_GET_RESPONSE\n");
 
-    int result = (int)sendto(args->sockets[0].fd, &bytes, 14, 0, (struct sockaddr*)&add, sizeof(add));
+    int result = (int)sendto(args->sockets[0].fd, &bytes, len, 0, (struct sockaddr*)&add, sizeof(add));
 
     if(result < 1) {
         perror("Q7_handler_send");
@@ -417,9 +558,9 @@ static states Q7_handler(node *args){
     accept_predacessor(args);
 
     //Parse response
-    int type = read_pdu_type(&args->sockets[3], NET_JOIN_RESPONSE, &args->socketBuffers[3], TCP);
+    int type = read_pdu_type(args, &args->sockets[3], JOIN_RESPONSE_TYPE, &args->socketBuffers[3], TCP);
     struct NET_JOIN_RESPONSE_PDU *resp = malloc(sizeof(struct NET_JOIN_RESPONSE_PDU));
-    int len = parse_net_join_response(type, args->socketBuffers[3].buffer, resp);
+    len = parse_net_join_response(type, args->socketBuffers[3].buffer, resp);
 
     save_last_pdu(args, resp);
 
@@ -441,7 +582,7 @@ static states Q8_handler(node *args) {
 
     printf("    Initilize table\n");
 
-    args->table = hash_table_create(resp->range_start, resp->range_end);
+    args->table = open_table(args, resp->range_start, resp->range_end);
 
     printf("    Connect to successor\n");
     args->successor->sin_family = AF_INET;
@@ -450,6 +591,19 @@ static states Q8_handler(node *args) {
 
     connect_socket(args->sockets[1].fd, *args->successor);
 
+    //Entries saved outside of the new range are handed to the ring, the successor forwards them to their owner
+    if(args->table->minHash < resp->range_start) {
+        hash_table *range = hash_table_detach_range(args->table, args->table->minHash, resp->range_start - 1);
+        printf("    Forward saved entries [%" PRIu64 ":%" PRIu64 "]\n", (uint64_t)range->minHash, (uint64_t)range->maxHash);
+        send_entry_range(range, args->sockets[1].fd);
+    }
+
+    if(args->table->maxHash > resp->range_end) {
+        hash_table *range = hash_table_detach_range(args->table, resp->range_end + 1, args->table->maxHash);
+        printf("    Forward saved entries [%" PRIu64 ":%" PRIu64 "]\n", (uint64_t)range->minHash, (uint64_t)range->maxHash);
+        send_entry_range(range, args->sockets[1].fd);
+    }
+
     return Q6;
 }
 
@@ -467,8 +621,15 @@ static states Q9_handler(node *args){
     if (type == VAL_INSERT) {
         printf("    Inserting hash table entry\n");
         struct VAL_INSERT_PDU *pdu = args->lastPdu;
-        hash_table_entry *entry = hash_table_create_entry((char*)(&pdu->ssn[0]), (char*)pdu->name, (char*)pdu->email);
-        int status = hash_table_insert(args->table, entry);
+        int status = hash_table_insert(args->table, (char*)pdu->ssn, (char*)pdu->name, pdu->name_length, (char*)pdu->email, pdu->email_length);
+
+        if(status == 0 && args->log) {
+            wal_append_insert(args->log, (char*)pdu->ssn, (char*)pdu->name, pdu->name_length, (char*)pdu->email, pdu->email_length);
+        }
+
+        if(status == 0) {
+            ssn_index_add(args->index, args->table, (char*)pdu->ssn);
+        }
 
         if(status != 0) {
             printf("    Outside the hash range. Forwarding VAL_INSERT\n");
@@ -479,10 +640,10 @@ static states Q9_handler(node *args){
 
             serialize_val_insert_pdu(bytes, *pdu);
 
-            send(args->sockets[1].fd, bytes, packetLen, 0);
+            send_stream(args, args->sockets[1].fd, bytes, packetLen);
         }
         else {
-            printf("    Insert {ssn: %.12s name: %s email: %s}\n", entry->ssn, entry->name, entry->email);
+            printf("    Insert {ssn: %.12s name: %s email: %s}\n", pdu->ssn, pdu->name, pdu->email);
         }
 
         free(pdu->name);
@@ -492,16 +653,7 @@ static states Q9_handler(node *args){
         printf("    Looking up hash table entry\n");
         struct VAL_LOOKUP_PDU *pdu = args->lastPdu;
 
-        struct VAL_LOOKUP_RESPONSE_PDU response = {
-                VAL_LOOKUP_RESPONSE,
-                0,
-                0,
-                0,
-                0,
-                0,
-        };
-
-        hash_table_entry entry = {NULL, NULL, NULL};
+        hash_table_entry entry = {};
         int status = hash_table_lookup(args->table, (char*)pdu->ssn, &entry);
 
         if(status < 0) {
@@ -511,54 +663,78 @@ static states Q9_handler(node *args){
 
             serialize_val_lookup_pdu(buff, *pdu);
 
-            send(args->sockets[1].fd, &buff, VAL_LOOKUP_BASE_LENGTH, 0);
+            send_stream(args, args->sockets[1].fd, buff, VAL_LOOKUP_BASE_LENGTH);
             return Q6;
         }
 
-        if(entry.ssn != NULL){
-            response.name_length = strlen(entry.name);
-            response.email_length = strlen(entry.email);
-
-            for(int i = 0; i < 12; i++){
-                response.ssn[i] = entry.ssn[i];
-            }
-
-            response.email = calloc(response.email_length + 1, sizeof(char));
-            strcpy((char*)response.email, entry.email);
-            response.name = calloc(response.name_length + 1, sizeof(char));
-            strcpy((char*)response.name, entry.name);
-        }
-
-        char buff[VAL_LOOKUP_RESPONSE_BASE_LENGTH + response.email_length + response.name_length];
+        //The response is sent straight from the table record, nothing is copied or allocated
+        char header[VAL_LOOKUP_RESPONSE_HEADER_LENGTH];
+        struct iovec iov[2];
 
-        int len = serialize_val_lookup_response_pdu(buff, response);
+        int len = serialize_val_lookup_response_iov(header, iov, &entry);
 
-        printf("    VAL_LOOKUP_RESPONSE_PDU\n");
-        printf("        response.type = %d\n", response.type);
-        printf("        response.name_length = %d\n", response.name_length);
-        printf("        response.email_length = %d\n", response.email_length);
-        printf("        response.ssn = %.12s, expected = %.12s\n", response.ssn, entry.ssn);
-        printf("        response.email = %s, expected = %s\n", response.email, entry.email);
-        printf("        response.name = %s, expected = %s\n", response.name, entry.name);
+        printf("    VAL_LOOKUP_RESPONSE_PDU {ssn: %.12s name: %.*s email: %.*s length: %d}\n", header + 1, entry.nameLength, entry.name ? entry.name : "", entry.emailLength, entry.email ? entry.email : "", len);
 
         struct sockaddr_in addr = {};
         addr.sin_family = AF_INET;
         addr.sin_addr.s_addr = pdu->sender_address;
         addr.sin_port = pdu->sender_port;
 
-        sendto(args->sockets[0].fd, &buff, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+        send_datagram(args, iov, 2, &addr);
 
+    } else if (type == VAL_INSERT_BATCH) {
+        struct VAL_INSERT_BATCH_PDU *pdu = args->lastPdu;
 
-        if (entry.ssn != NULL){
-            free(response.name);
-            free(response.email);
+        hash_table_record records[pdu->count + 1];
+        int statuses[pdu->count + 1];
+
+        int count = parse_val_insert_batch_records(pdu, records);
+        int inserted = hash_table_insert_batch(args->table, records, count, statuses);
+
+        //The records outside the range are sent on as one batch, which is never longer than the one received
+        char forward[VAL_INSERT_BATCH_MAX_LENGTH];
+        struct VAL_INSERT_BATCH_PDU rest = {VAL_INSERT_BATCH, VAL_INSERT_BATCH_BASE_LENGTH, 0, NULL};
+
+        for(int i = 0; i < count; i++) {
+            if(statuses[i] != 0) {
+                rest.length += serialize_val_insert_batch_record(forward + rest.length, &records[i]);
+                rest.count += 1;
+                continue;
+            }
+
+            if(args->log) {
+                wal_append_insert(args->log, records[i].ssn, records[i].name, records[i].nameLength, records[i].email, records[i].emailLength);
+            }
+
+            ssn_index_add(args->index, args->table, records[i].ssn);
         }
 
+        printf("    Inserted %d of %d batched entries\n", inserted, count);
+
+        if(rest.count > 0) {
+            printf("    Forwarding %d entries in VAL_INSERT_BATCH\n", rest.count);
+
+            serialize_val_insert_batch_pdu(forward, rest);
+
+            send_stream(args, args->sockets[1].fd, forward, rest.length);
+        }
+
+        free(pdu->records);
+    } else if (type == VAL_LOOKUP_BATCH) {
+        struct VAL_LOOKUP_BATCH_PDU *pdu = args->lastPdu;
+
+        answer_lookup_batch(args, pdu);
+
+        free(pdu->ssns);
     } else if (type == VAL_REMOVE) {
         printf("    Removing hash table entry\n");
         struct VAL_REMOVE_PDU *pdu = args->lastPdu;
         int status = hash_table_remove(args->table, (char*)pdu->ssn);
 
+        if(status == 0 && args->log) {
+            wal_append_remove(args->log, (char*)pdu->ssn);
+        }
+
         if(status != 0) {
             printf("    Send to next\n");
 
@@ -566,8 +742,29 @@ static states Q9_handler(node *args){
 
             serialize_val_remove_pdu(buff, *pdu);
 
-            send(args->sockets[1].fd, &buff, VAL_REMOVE_BASE_LENGTH, 0);
+            send_stream(args, args->sockets[1].fd, buff, VAL_REMOVE_BASE_LENGTH);
+        }
+    } else if (type == VAL_SCAN) {
+        printf("    Scanning hash table entries\n");
+        struct VAL_SCAN_PDU *pdu = args->lastPdu;
+
+        if(!pdu->forwarded) {
+            pdu->forwarded = 1;
+            pdu->stop_hash = (hash_t)(args->table->minHash - 1);
         }
+
+        //Forward before scanning so the rest of the ring scans at the same time
+        if(pdu->stop_hash < args->table->minHash || pdu->stop_hash > args->table->maxHash) {
+            printf("    Send to next\n");
+
+            char buff[VAL_SCAN_BASE_LENGTH];
+
+            serialize_val_scan_pdu(buff, *pdu);
+
+            send_stream(args, args->sockets[1].fd, buff, VAL_SCAN_BASE_LENGTH);
+        }
+
+        send_scan_pages(args, pdu);
     }
 
     return Q6;
@@ -582,8 +779,11 @@ static states Q9_handler(node *args){
 static states Q10_handler(node *args){
     printf("[Q10]\n");
 
-    if(args->table->minHash == 0 && args->table->maxHash == 255) {
+    flush_sends(args);
+
+    if(args->table->minHash == 0 && args->table->maxHash == HASH_MAX) {
         printf("    No one is connected, exiting\n");
+        save_table(args);
         return EXIT;
     }
 
@@ -602,14 +802,14 @@ static states Q11_handler(node *args){
     printf("    Send NET_NEW_RANGE to successor\n");
 
     struct NET_NEW_RANGE_PDU pdu = {
-        NET_NEW_RANGE,
+        NEW_RANGE_TYPE,
         args->table->minHash,
         args->table->maxHash
     };
 
-    char buff[NET_NEW_RANGE_BASE_LENGTH];
+    char buff[NET_NEW_RANGE_WIDE_BASE_LENGTH];
 
-    serialize_net_new_range_pdu(buff, pdu);
+    int len = serialize_net_new_range_pdu(buff, pdu);
 
     int socket = 1;
 
@@ -617,7 +817,7 @@ static states Q11_handler(node *args){
         socket = 3;
     }
 
-    int status = (int)send(args->sockets[socket].fd, buff, NET_NEW_RANGE_BASE_LENGTH, 0);
+    int status = (int)send(args->sockets[socket].fd, buff, len, 0);
 
     if (status < 0){
         perror("[Q11] Sending response");
@@ -628,7 +828,7 @@ static states Q11_handler(node *args){
 
     printf("    Read NET_NEW_RANGE_RESPONSE from successor\n");
 
-    read_pdu_type(&args->sockets[socket], NET_NEW_RANGE_RESPONSE, &args->socketBuffers[socket], TCP);
+    read_pdu_type(args, &args->sockets[socket], NET_NEW_RANGE_RESPONSE, &args->socketBuffers[socket], TCP);
 
     return Q18;
 }
@@ -643,9 +843,11 @@ static states Q11_handler(node *args){
 static states Q12_handler(node *args){
     printf("[Q12]\n");
 
+    flush_sends(args);
+
     struct NET_JOIN_PDU *resp = args->lastPdu;
 
-    if (args->table->minHash == 0 && args->table->maxHash == 255){
+    if (args->table->minHash == 0 && args->table->maxHash == HASH_MAX){
         printf("    No node connected, moving to Q5\n");
         return Q5;
     }
@@ -682,6 +884,7 @@ static states Q13_handler(node *args){
     };
 
     send(args->sockets[1].fd, &pdu, NET_CLOSE_CONNECTION_BASE_LENGTH, 0);
+    forget_socket(args, args->sockets[1].fd);
     close(args->sockets[1].fd);
 
     args->sockets[1].fd = create_socket(SOCK_STREAM);
@@ -692,21 +895,21 @@ static states Q13_handler(node *args){
 
     connect_socket(args->sockets[1].fd, *args->successor);
 
-    int min = (args->table->maxHash - args->table->minHash)/2 + args->table->minHash;
+    hash_t min = (args->table->maxHash - args->table->minHash)/2 + args->table->minHash;
 
     //Send NET_JOIN_RESPONSE to prospect
     struct NET_JOIN_RESPONSE_PDU respPdu = {
-            NET_JOIN_RESPONSE,
+            JOIN_RESPONSE_TYPE,
             succ_add.sin_addr.s_addr,
             succ_add.sin_port,
             min,
             args->table->maxHash
     };
 
-    char bytes[NET_JOIN_RESPONSE_BASE_LENGTH];
-    serialize_net_join_response_pdu(bytes, respPdu);
+    char bytes[NET_JOIN_RESPONSE_WIDE_BASE_LENGTH];
+    int len = serialize_net_join_response_pdu(bytes, respPdu);
 
-    send(args->sockets[1].fd, &bytes, NET_JOIN_RESPONSE_BASE_LENGTH, 0);
+    send(args->sockets[1].fd, &bytes, len, 0);
 
     //Transfer upper half of entry range to successor
     transfer_entry_range(args, args->sockets[1].fd, min);
@@ -734,10 +937,10 @@ static states Q14_handler(node *args){
         lastPdu->max_port = *args->listeningPort;
     }
 
-    char bytes[NET_JOIN_BASE_LENGTH];
-    serialize_net_join_pdu(bytes, *lastPdu);
+    char bytes[NET_JOIN_WIDE_BASE_LENGTH];
+    int len = serialize_net_join_pdu(bytes, *lastPdu);
 
-    int result = (int)send(args->sockets[1].fd, &bytes, NET_JOIN_BASE_LENGTH, 0);
+    int result = (int)send(args->sockets[1].fd, &bytes, len, 0);
 
     if(result == -1) {
         perror("[Q14] send");
@@ -757,27 +960,29 @@ static states Q14_handler(node *args){
 static states Q15_handler(node *args) {
     printf("[Q15]\n");
 
+    flush_sends(args);
+
     struct NET_NEW_RANGE_PDU *lastPdu = args->lastPdu;
 
-    printf("    Update hash range {range_start:%d, range_end:%d}, got {minHash:%d, maxHash:%d}\n", lastPdu->range_start, lastPdu->range_end, args->table->minHash, args->table->maxHash);
+    printf("    Update hash range {range_start:%" PRIu64 ", range_end:%" PRIu64 "}, got {minHash:%" PRIu64 ", maxHash:%" PRIu64 "}\n", lastPdu->range_start, lastPdu->range_end, (uint64_t)args->table->minHash, (uint64_t)args->table->maxHash);
 
-    int min = lastPdu->range_start;
+    hash_t min = lastPdu->range_start;
     if (args->table->minHash < min){
         min = args->table->minHash;
     }
 
-    int max = lastPdu->range_end;
+    hash_t max = lastPdu->range_end;
     if (args->table->maxHash > max){
         max = args->table->maxHash;
     }
 
-    printf("    New table range: [%d:%d]\n", min, max);
+    printf("    New table range: [%" PRIu64 ":%" PRIu64 "]\n", (uint64_t)min, (uint64_t)max);
 
     struct NET_NEW_RANGE_RESPONSE_PDU resp = {
         NET_NEW_RANGE_RESPONSE
     };
 
-    if(args->table->maxHash != 255 && lastPdu->range_start == args->table->maxHash+1) {
+    if(args->table->maxHash != HASH_MAX && lastPdu->range_start == (hash_t)(args->table->maxHash + 1)) {
         printf("    Sent response to successor\n");
         send(args->sockets[1].fd, &resp, NET_NEW_RANGE_RESPONSE_BASE_LENGTH, 0);
     } else{
@@ -786,6 +991,9 @@ static states Q15_handler(node *args) {
     }
 
     args->table = hash_table_resize(args->table, min, max);
+    print_filter_stats(args->table);
+
+    save_table(args);
 
     return Q6;
 }
@@ -799,14 +1007,17 @@ static states Q15_handler(node *args) {
 static states Q16_handler(node *args) {
     printf("[Q16]\n");
 
+    flush_sends(args);
+
     struct NET_LEAVING_PDU *lastPdu = args->lastPdu;
 
     //Disconnect from successor
     printf("    Disconnect from successor\n");
+    forget_socket(args, args->sockets[1].fd);
     close(args->sockets[1].fd);
     args->sockets[1].fd = create_socket(SOCK_STREAM);
 
-    if (args->table->minHash != 0 || args->table->maxHash != 255){
+    if (args->table->minHash != 0 || args->table->maxHash != HASH_MAX){
         //Connect to new successor
         printf("    Connect to new successor\n");
         args->successor->sin_addr.s_addr = lastPdu->new_address;
@@ -827,11 +1038,14 @@ static states Q16_handler(node *args) {
 static states Q17_handler(node *args) {
     printf("[Q17]\n");
 
+    flush_sends(args);
+
     printf("    Disconnect from predacessor\n");
+    forget_socket(args, args->sockets[3].fd);
     close(args->sockets[3].fd);
     args->sockets[3].fd = create_socket(SOCK_STREAM);
 
-    if(args->table->minHash == 0 && args->table->maxHash == 255){
+    if(args->table->minHash == 0 && args->table->maxHash == HASH_MAX){
         args->predecessor->sin_addr.s_addr = 0;
         args->predecessor->sin_port = 0;
     } else {
@@ -866,6 +1080,12 @@ static states Q18_handler(node *args) {
         transfer_entry_range(args, args->sockets[1].fd, args->table->minHash);
     }
 
+    //The entries now belong to other nodes
+    if(args->dataFile) {
+        unlink(args->dataFile);
+        wal_truncate(args->log);
+    }
+
     struct NET_CLOSE_CONNECTION_PDU pdu = {
         NET_CLOSE_CONNECTION
     };
@@ -940,82 +1160,150 @@ static void save_last_pdu(node *n, void *pdu) {
 }
 
 /**
- * Clears a socket buffer
+ * Clears bytes from the start of a socket buffer
  *
  * @param buffer
  * @param bytes
  * @returns void
  */
 static void clear_buffer(socket_buffer *buffer, int bytes) {
-    for(int i = 0; i < buffer->len; i++) {
-        if (i + bytes >= buffer->len){
-            buffer->buffer[i] = '\0';
-        } else{
-            buffer->buffer[i] = buffer->buffer[i + bytes];
-        }
-    }
-    buffer->len -= bytes;
-    printf("    Clearing buffer bytes: %d, new length: %d\n", bytes, buffer->len);
+    socket_buffer_consume(buffer, bytes);
 }
 
 /**
- * Transfers the entry range from one node to another
+ * Transfers the entry range from one node to another. The range is detached from the table first so the
+ * records are streamed from the detached buckets in batches of VAL_INSERT PDUs and then released at once
  *
  * @param args
  * @param fd
  * @param rangeMin
  * @returns void
  */
-static void transfer_entry_range(node *args, int fd, int rangeMin) {
-    int bucketsLength = (args->table->maxHash - rangeMin) + 1;
-    bucket *buckets = hash_table_get_buckets_from(args->table, rangeMin - args->table->minHash);
+static void transfer_entry_range(node *args, int fd, hash_t rangeMin) {
+    hash_table *range;
 
-    for(int i = 0; i < bucketsLength; i++) {
-        for(int j = 0; j < buckets[i].length; j++) {
+    if(rangeMin > args->table->minHash) {
+        range = hash_table_detach_range(args->table, rangeMin, args->table->maxHash);
+    } else {
+        range = args->table;
+        args->table = NULL;
+    }
 
-            uint8_t nameLen = strlen(buckets[i].list[j]->name);
-            uint8_t emailLength = strlen(buckets[i].list[j]->email);
+    send_entry_range(range, fd);
 
-            struct VAL_INSERT_PDU pdu = {
-            };
+    if(args->table) {
+        print_filter_stats(args->table);
+    }
 
-            pdu.type = VAL_INSERT;
+    //Snapshot right away so a restart does not replay entries that now belong to the successor
+    save_table(args);
+}
 
-            for(int k = 0; k < SSN_LENGTH; k++) {
-                pdu.ssn[k] = buckets[i].list[j]->ssn[k];
-            }
+/**
+ * Sends every entry of a range as VAL_INSERT PDUs, batched into large sends, and destroys the range
+ *
+ * @param range
+ * @param fd
+ * @returns void
+ */
+static void send_entry_range(hash_table *range, int fd) {
+    static char bytes[TRANSFER_BUFF_SIZE];
+    int len = 0;
 
-            pdu.name_length = nameLen;
+    int bucketsLength = hash_table_get_bucket_count(range);
+    bucket *buckets = hash_table_get_buckets_from(range, 0);
 
-            pdu.name = calloc(pdu.name_length, sizeof(char));
+    for(int i = 0; i < bucketsLength; i++) {
+        hash_table_entry entry;
 
-            for(int k = 0; k < nameLen; k++) {
-                pdu.name[k] = buckets[i].list[j]->name[k];
+        for(int j = hash_table_bucket_next(&buckets[i], 0, &entry); j >= 0; j = hash_table_bucket_next(&buckets[i], j + 1, &entry)) {
+            if(len + VAL_INSERT_BASE_LENGTH + entry.nameLength + entry.emailLength > TRANSFER_BUFF_SIZE) {
+                send(fd, bytes, len, 0);
+                len = 0;
             }
 
-            pdu.email_length = emailLength;
+            len += serialize_val_insert_entry(bytes + len, &entry);
+        }
+    }
 
-            pdu.email = calloc(pdu.email_length, sizeof(char));
+    if(len > 0) {
+        send(fd, bytes, len, 0);
+    }
 
-            for(int k = 0; k < emailLength; k++) {
-                pdu.email[k] = buckets[i].list[j]->email[k];
-            }
+#if HASH_CONCURRENT
+    //The range can be the whole table the lookup workers were reading
+    epoch_synchronize();
+#endif
+    hash_table_destroy(range);
+}
 
-            char bytes[VAL_INSERT_BASE_LENGTH + nameLen + emailLength];
+/**
+ * Opens the table saved in the data file and replays the write-ahead log on top of it, or creates an empty
+ * table when the node has no data file. A recovered table covers every hash since logged mutations can be
+ * outside of the saved range, the caller hands off the part outside of min to max
+ *
+ * @param args
+ * @param min
+ * @param max
+ * @returns the table
+ */
+static hash_table *open_table(node *args, hash_t min, hash_t max) {
+    if(!args->dataFile) {
+        args->index = ssn_index_create();
+        return hash_table_create(min, max);
+    }
 
-            int len = serialize_val_insert_pdu((char*)&bytes, pdu);
+    hash_table *table = hash_table_open(args->dataFile);
 
-            send(fd, &bytes, len, 0);
+    if(table) {
+        printf("    Loaded saved table [%" PRIu64 ":%" PRIu64 "] from %s\n", (uint64_t)table->minHash, (uint64_t)table->maxHash, args->dataFile);
+        hash_table_resize(table, 0, HASH_MAX);
+    } else {
+        table = hash_table_create(0, HASH_MAX);
+    }
 
-            hash_table_remove(args->table, buckets[i].list[j]->ssn);
-        }
+    args->savedChanges = table->changes;
+
+    long records = wal_replay(args->logFile, table);
+
+    if(records < 0) {
+        fprintf(stderr, "Could not replay %s\n", args->logFile);
+        exit(EXIT_FAILURE);
     }
 
-    if(rangeMin > args->table->minHash) {
-        args->table = hash_table_resize(args->table, args->table->minHash, rangeMin-1);
-    }else {
-        hash_table_destroy(args->table);
-        args->table = NULL;
+    printf("    Replayed %ld mutations from %s\n", records, args->logFile);
+
+    args->log = wal_open(args->logFile);
+
+    if(!args->log) {
+        exit(EXIT_FAILURE);
+    }
+
+    args->index = ssn_index_create();
+    ssn_index_build(args->index, table);
+
+    return table;
+}
+
+/**
+ * Saves the table to the data file if it has changed since it was last saved and truncates the
+ * write-ahead log that the saved table now contains
+ *
+ * @param args
+ * @returns void
+ */
+static void save_table(node *args) {
+    if(!args->dataFile || !args->table || args->table->changes == args->savedChanges) {
+        return;
+    }
+
+    printf("    Saving table to %s\n", args->dataFile);
+
+    wal_commit(args->log);
+
+    if(hash_table_save(args->table, args->dataFile) == 0) {
+        args->savedChanges = args->table->changes;
+        wal_truncate(args->log);
     }
 }
 
@@ -1023,26 +1311,38 @@ static void transfer_entry_range(node *args, int fd, int rangeMin) {
 /**
  * Reads the PDU and returns it's type, storing the data in the buffer
  *
+ * @param args
  * @param fd
  * @param expectedType
  * @param pdu
  * @param protocol
  * @returns the type
  */
-static int read_pdu_type(struct pollfd *fd, int expectedType, socket_buffer *pdu, int protocol) {
+static int read_pdu_type(node *args, struct pollfd *fd, int expectedType, socket_buffer *pdu, int protocol) {
     int type;
     do {
+#if IO_URING
+        //The ring reads every socket, so whatever arrives is waited for in it
+        (void)fd;
+        (void)protocol;
+        watch_sockets(args);
+        uring_wait(args->ring, -1);
+#else
+        (void)args;
         if(protocol == TCP) {
             read_pdu(fd, pdu, 1, -1);
         } else {
             read_udp_pdu(fd, pdu, -1);
         }
-        type = parse_pdu_type(pdu->buffer);
+#endif
+        //The bytes after the unread ones are left from earlier PDUs
+        type = pdu->len > 0 ? parse_pdu_type(pdu->buffer) : 0;
     } while(type != expectedType);
 
     return type;
 }
 
+#if !IO_URING
 /**
  * Reads the PDU from the UDP, storing the data in the buffer
  *
@@ -1057,42 +1357,8 @@ static void read_udp_pdu(struct pollfd *fd, socket_buffer *buff, int timeout) {
         exit(1);
     }
 
-    struct sockaddr_in add = {};
-    add.sin_family = AF_INET;
-
     if(fd->revents & POLLIN){
-        while(1) {
-
-            socklen_t l = sizeof(struct sockaddr_in);
-
-            int readBytes = (int)recvfrom(fd->fd, buff->buffer + buff->len, BUFF_SIZE - buff->len, MSG_DONTWAIT | MSG_PEEK, (struct sockaddr*)&add, &l);
-
-            if(readBytes < 0 && !(errno == EWOULDBLOCK || errno == ENOTCONN)){
-                perror("TCP_READ_PEEK");
-                exit(EXIT_FAILURE);
-            }
-
-            int result;
-
-            if(readBytes + buff->len >= BUFF_SIZE) {
-                break;
-            }
-
-            result = (int)recvfrom(fd->fd, buff->buffer + buff->len, BUFF_SIZE - buff->len, MSG_DONTWAIT, (struct sockaddr*)&add, &l);
-
-            if(result == -1) {
-                if (errno == EWOULDBLOCK || errno == ENOTCONN) {
-                    break;
-                } else {
-                    perror("TCP_READ");
-                    exit(EXIT_FAILURE);
-                }
-            } else if(result == 0) {
-                break;
-            } else {
-                buff->len += result;
-            }
-        }
+        receive_datagrams(fd->fd, buff);
     }
 }
 
@@ -1130,34 +1396,281 @@ static void read_pdu(struct pollfd *fd, socket_buffer *buff, int len, int timeou
 
     for(int i = 0; i < size; i++){
         if(activeFd[i].revents & POLLIN){
-            while(1) {
+            receive_stream(activeFd[i].fd, activeBuffers[i]);
+        }
+    }
+}
+#endif
+
+/**
+ * Reads the datagrams waiting on a UDP socket into the buffer, as many as fit
+ *
+ * @param fd
+ * @param context the socket_buffer
+ * @returns 1 if the socket has nothing more to read, 0 if the buffer filled up first
+ */
+static int receive_datagrams(int fd, void *context) {
+    return socket_buffer_receive_datagrams(context, fd, DATAGRAM_MAX);
+}
 
-                int readBytes = (int)recv(activeFd[i].fd, activeBuffers[i]->buffer + activeBuffers[i]->len, BUFF_SIZE - activeBuffers[i]->len, MSG_DONTWAIT | MSG_PEEK);
+/**
+ * Reads what a TCP socket has into the buffer, as much as fits
+ *
+ * @param fd
+ * @param context the socket_buffer
+ * @returns 1 if the socket has nothing more to read or is closed, 0 if the buffer filled up first
+ */
+static int receive_stream(int fd, void *context) {
+    return socket_buffer_receive_stream(context, fd);
+}
 
-                if(readBytes < 0 && !(errno == EWOULDBLOCK || errno == ENOTCONN)){
-                    perror("TCP_READ_PEEK");
-                    exit(EXIT_FAILURE);
-                }
+/**
+ * Points the reactor of the node at its current sockets, creating the reactor the first time. The listening
+ * socket is left out since joins arrive over UDP and are accepted in their own states
+ *
+ * @param args
+ * @returns void
+ */
+static void watch_sockets(node *args) {
+#if IO_URING
+    if(!args->ring) {
+        args->ring = uring_create(REACTOR_TICK);
+    }
 
-                if(readBytes + activeBuffers[i]->len > BUFF_SIZE) {
-                    break;
-                }
+    uring_watch(args->ring, 0, args->sockets[0].fd, 1, &args->socketBuffers[0]);
+    uring_watch(args->ring, 1, args->sockets[1].fd, 0, &args->socketBuffers[1]);
+    uring_watch(args->ring, 3, args->sockets[3].fd, 0, &args->socketBuffers[3]);
+#if UDP_WORKERS > 0
+    //The workers answer the lookups for the range and hand every other datagram over
+    if(args->workers) {
+        uring_watch(args->ring, 4, args->workers->handoff.fd, 1, &args->socketBuffers[0]);
+    }
+#endif
+#else
+    if(!args->reactor) {
+        args->reactor = reactor_create(REACTOR_TICK);
+    }
 
-                int result = (int)recv(activeFd[i].fd, activeBuffers[i]->buffer + activeBuffers[i]->len, BUFF_SIZE - activeBuffers[i]->len, MSG_DONTWAIT);
+    reactor_watch(args->reactor, 0, args->sockets[0].fd, receive_datagrams, &args->socketBuffers[0]);
+    reactor_watch(args->reactor, 1, args->sockets[1].fd, receive_stream, &args->socketBuffers[1]);
+    reactor_watch(args->reactor, 3, args->sockets[3].fd, receive_stream, &args->socketBuffers[3]);
+#if UDP_WORKERS > 0
+    //The workers answer the lookups for the range and hand every other datagram over
+    reactor_watch(args->reactor, 4, args->workers->handoff.fd, receive_datagrams, &args->socketBuffers[0]);
+#endif
+#endif
+}
 
-                if(result == -1) {
-                    if (errno == EWOULDBLOCK || errno == ENOTCONN) {
-                        break;
-                    } else {
-                        perror("TCP_READ");
-                        exit(EXIT_FAILURE);
-                    }
-                } else if(result == 0) {
-                  break;
-                } else {
-                    activeBuffers[i]->len += result;
-                }
+/**
+ * Stops reading a socket that is about to be closed
+ *
+ * @param args
+ * @param fd
+ * @returns void
+ */
+static void forget_socket(node *args, int fd) {
+#if IO_URING
+    uring_forget(args->ring, fd);
+#else
+    reactor_forget(args->reactor, fd);
+#endif
+}
+
+/**
+ * Sends a PDU to the successor or predecessor. With IO_URING it is queued and goes out with the next batch,
+ * flush_sends has to come before anything else writes to the socket
+ *
+ * @param args
+ * @param fd
+ * @param bytes
+ * @param len
+ * @returns void
+ */
+static void send_stream(node *args, int fd, const void *bytes, int len) {
+#if IO_URING
+    uring_send(args->ring, fd, &(struct iovec){(void*)bytes, len}, 1, NULL);
+#else
+    (void)args;
+    send(fd, bytes, len, 0);
+#endif
+}
+
+/**
+ * Sends a PDU over UDP. With IO_URING it is queued and goes out with the next batch
+ *
+ * @param args
+ * @param iov the PDU
+ * @param count the number of iovecs
+ * @param addr
+ * @returns void
+ */
+static void send_datagram(node *args, const struct iovec *iov, int count, const struct sockaddr_in *addr) {
+#if IO_URING
+    uring_send(args->ring, args->sockets[0].fd, iov, count, addr);
+#else
+    struct msghdr message = {};
+    message.msg_name = (void*)addr;
+    message.msg_namelen = sizeof(*addr);
+    message.msg_iov = (struct iovec*)iov;
+    message.msg_iovlen = count;
+
+    sendmsg(args->sockets[0].fd, &message, 0);
+#endif
+}
+
+/**
+ * Sends every queued PDU, the states that talk to the neighbours directly start with this
+ *
+ * @param args
+ * @returns void
+ */
+static void flush_sends(node *args) {
+#if IO_URING
+    if(args->ring) {
+        uring_flush(args->ring);
+    }
+#else
+    (void)args;
+#endif
+}
+
+/**
+ * Sends the entries of the table that match a scan to the requester, in pages of at most SCAN_PAGE_SIZE bytes.
+ * The last page is sent even if it is empty so the requester knows that this range is done
+ *
+ * @param args
+ * @param pdu
+ * @returns void
+ */
+static void send_scan_pages(node *args, struct VAL_SCAN_PDU *pdu) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = pdu->sender_address;
+    addr.sin_port = pdu->sender_port;
+
+    struct VAL_SCAN_RESPONSE_PDU response = {
+            VAL_SCAN_RESPONSE,
+            args->table->minHash,
+            args->table->maxHash,
+            0,
+            0
+    };
+
+    char page[SCAN_PAGE_SIZE];
+    int len = VAL_SCAN_RESPONSE_BASE_LENGTH;
+    int pages = 0;
+
+    uint64_t next = 0;
+    uint64_t last = 0;
+
+    if(ssn_index_prefix_range((char*)pdu->prefix, pdu->prefix_length, &next, &last) < 0) {
+        //Only digit ssns are ordered, nothing matches any other prefix
+        next = 1;
+    }
+
+    hash_table_entry entries[SCAN_BATCH];
+
+    while(next <= last) {
+        int found = ssn_index_scan(args->index, args->table, &next, last, entries, SCAN_BATCH);
+
+        for(int i = 0; i < found; i++) {
+            int size = VAL_INSERT_BASE_LENGTH - 1 + entries[i].nameLength + entries[i].emailLength;
+
+            if(len + size > SCAN_PAGE_SIZE) {
+                serialize_val_scan_response_pdu(page, response);
+                send_datagram(args, &(struct iovec){page, len}, 1, &addr);
+
+                response.count = 0;
+                len = VAL_SCAN_RESPONSE_BASE_LENGTH;
+                pages += 1;
             }
+
+            len += serialize_val_scan_entry(page + len, &entries[i]);
+            response.count += 1;
         }
     }
-}
\ No newline at end of file
+
+    response.last_page = 1;
+    serialize_val_scan_response_pdu(page, response);
+    send_datagram(args, &(struct iovec){page, len}, 1, &addr);
+
+    printf("    Sent %d scan pages for [%" PRIu64 ":%" PRIu64 "]\n", pages + 1, response.range_start, response.range_end);
+}
+
+/**
+ * Answers the ssns of a VAL_LOOKUP_BATCH that are in the range of the node, in pages of at most
+ * SCAN_PAGE_SIZE bytes sent straight to the sender, and passes the other ssns on to the successor
+ * as one VAL_LOOKUP_BATCH
+ *
+ * @param args
+ * @param pdu
+ * @returns void
+ */
+static void answer_lookup_batch(node *args, struct VAL_LOOKUP_BATCH_PDU *pdu) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = pdu->sender_address;
+    addr.sin_port = pdu->sender_port;
+
+    struct VAL_LOOKUP_BATCH_RESPONSE_PDU response = {VAL_LOOKUP_BATCH_RESPONSE, VAL_LOOKUP_BATCH_RESPONSE_BASE_LENGTH, 0};
+    char page[SCAN_PAGE_SIZE];
+
+    //The ssns that are passed on are moved to the front of the batch
+    struct VAL_LOOKUP_BATCH_PDU rest = *pdu;
+    rest.count = 0;
+
+    int answered = 0;
+
+    for(int i = 0; i < pdu->count; i++) {
+        uint8_t *ssn = pdu->ssns + i * SSN_LENGTH;
+        hash_table_entry entry = {};
+
+        if(hash_table_lookup(args->table, (char*)ssn, &entry) < 0) {
+            memmove(rest.ssns + rest.count * SSN_LENGTH, ssn, SSN_LENGTH);
+            rest.count += 1;
+            continue;
+        }
+
+        if(response.length + 1 + VAL_LOOKUP_RESPONSE_BASE_LENGTH - 1 + entry.nameLength + entry.emailLength > SCAN_PAGE_SIZE) {
+            serialize_val_lookup_batch_response_pdu(page, response);
+            send_datagram(args, &(struct iovec){page, response.length}, 1, &addr);
+
+            response.length = VAL_LOOKUP_BATCH_RESPONSE_BASE_LENGTH;
+            response.count = 0;
+        }
+
+        response.length += serialize_val_lookup_batch_entry(page + response.length, ssn, &entry);
+        response.count += 1;
+        answered += 1;
+    }
+
+    if(response.count > 0) {
+        serialize_val_lookup_batch_response_pdu(page, response);
+        send_datagram(args, &(struct iovec){page, response.length}, 1, &addr);
+    }
+
+    printf("    Answered %d of %d batched lookups\n", answered, pdu->count);
+
+    if(rest.count > 0) {
+        printf("    Forwarding %d lookups in VAL_LOOKUP_BATCH\n", rest.count);
+
+        char bytes[VAL_LOOKUP_BATCH_MAX_LENGTH];
+        int len = serialize_val_lookup_batch_pdu(bytes, rest);
+
+        send_stream(args, args->sockets[1].fd, bytes, len);
+    }
+}
+
+/**
+ * Prints the memory use and false positive rate of the bloom filters of the table
+ *
+ * @param table
+ * @returns void
+ */
+static void print_filter_stats(hash_table *table) {
+    hash_table_filter_stats stats;
+    hash_table_get_filter_stats(table, &stats);
+
+    printf("    Filter {bytes: %zu, entries: %ld, estimated false positives: %.2f%%, rejected: %lu, false positives: %lu}\n",
+           stats.bytes, stats.entries, stats.estimatedFalsePositiveRate * 100, stats.rejects, stats.falsePositives);
+}
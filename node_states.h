@@ -18,10 +18,30 @@
 #include <errno.h>
 #include <unistd.h>
 #define maxListeners 5
-#define BUFF_SIZE 1024
+#define BUFF_SIZE (2 * VAL_INSERT_BATCH_MAX_LENGTH)
+#define DATAGRAM_MAX VAL_INSERT_BATCH_MAX_LENGTH
+#define TRANSFER_BUFF_SIZE 65536
+#define SAVE_INTERVAL 30
+#define WAL_SNAPSHOT_RECORDS 100000
+#define COMPACT_BUDGET 16
+#define REACTOR_TICK 500
+#define DISPATCH_BUDGET 32
+#define SCAN_PAGE_SIZE 1400
+#define SCAN_BATCH 64
 #define UDP 100
 #define TCP 101
 
+//A keyspace wider than 8 bits needs the PDUs with 8 byte range fields
+#if HASH_BITS == 8
+#define JOIN_TYPE NET_JOIN
+#define JOIN_RESPONSE_TYPE NET_JOIN_RESPONSE
+#define NEW_RANGE_TYPE NET_NEW_RANGE
+#else
+#define JOIN_TYPE NET_JOIN_WIDE
+#define JOIN_RESPONSE_TYPE NET_JOIN_RESPONSE_WIDE
+#define NEW_RANGE_TYPE NET_NEW_RANGE_WIDE
+#endif
+
 /**
  * 
  * Enum representing the states for the state machine
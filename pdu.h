@@ -14,11 +14,19 @@
 #define NET_NEW_RANGE 6
 #define NET_LEAVING 7
 #define NET_NEW_RANGE_RESPONSE 8
+#define NET_JOIN_WIDE 9
+#define NET_JOIN_RESPONSE_WIDE 10
+#define NET_NEW_RANGE_WIDE 11
 
 #define VAL_INSERT 100
 #define VAL_REMOVE 101
 #define VAL_LOOKUP 102
 #define VAL_LOOKUP_RESPONSE 103
+#define VAL_SCAN 104
+#define VAL_SCAN_RESPONSE 105
+#define VAL_INSERT_BATCH 106
+#define VAL_LOOKUP_BATCH 107
+#define VAL_LOOKUP_BATCH_RESPONSE 108
 
 #define STUN_LOOKUP 200
 #define STUN_RESPONSE 201
@@ -27,13 +35,24 @@
 #define GET_NODE_RESPONSE_BASE_LENGTH 7
 #define NET_JOIN_RESPONSE_BASE_LENGTH 9
 #define NET_JOIN_BASE_LENGTH 14
+#define NET_JOIN_WIDE_BASE_LENGTH 21
+#define NET_JOIN_RESPONSE_WIDE_BASE_LENGTH 23
 #define VAL_INSERT_BASE_LENGTH 3 + SSN_LENGTH
 #define VAL_REMOVE_BASE_LENGTH 1 + SSN_LENGTH
 #define VAL_LOOKUP_BASE_LENGTH 7 + SSN_LENGTH
 #define VAL_LOOKUP_RESPONSE_BASE_LENGTH VAL_INSERT_BASE_LENGTH
+#define VAL_LOOKUP_RESPONSE_HEADER_LENGTH (1 + SSN_LENGTH)
+#define VAL_SCAN_BASE_LENGTH 17 + SSN_LENGTH
+#define VAL_SCAN_RESPONSE_BASE_LENGTH 19
+#define VAL_INSERT_BATCH_BASE_LENGTH 5
+#define VAL_INSERT_BATCH_MAX_LENGTH 8192
+#define VAL_LOOKUP_BATCH_BASE_LENGTH 11
+#define VAL_LOOKUP_BATCH_MAX_LENGTH 8192
+#define VAL_LOOKUP_BATCH_RESPONSE_BASE_LENGTH 5
 #define NET_CLOSE_CONNECTION_BASE_LENGTH 1
 #define NET_LEAVING_BASE_LENGTH 7
 #define NET_NEW_RANGE_BASE_LENGTH 3
+#define NET_NEW_RANGE_WIDE_BASE_LENGTH 17
 #define NET_NEW_RANGE_RESPONSE_BASE_LENGTH 1
 
 #ifndef PDU_DEF
@@ -53,11 +72,15 @@ struct NET_GET_NODE_RESPONSE_PDU {
     uint16_t port;
 };
 
+/**
+ * The range fields of NET_JOIN, NET_JOIN_RESPONSE and NET_NEW_RANGE are one byte on the wire. The _WIDE
+ * variants carry them as 8 bytes for nodes built with a keyspace wider than 8 bits
+ */
 struct NET_JOIN_PDU {
     uint8_t type;
     uint32_t src_address;
     uint16_t src_port;
-    uint8_t max_span;
+    uint64_t max_span;
     uint32_t max_address;
     uint16_t max_port;
 };
@@ -66,8 +89,8 @@ struct NET_JOIN_RESPONSE_PDU {
     uint8_t type;
     uint32_t next_address;
     uint16_t next_port;
-    uint8_t range_start;
-    uint8_t range_end;
+    uint64_t range_start;
+    uint64_t range_end;
 };
 
 struct NET_CLOSE_CONNECTION_PDU {
@@ -76,8 +99,8 @@ struct NET_CLOSE_CONNECTION_PDU {
 
 struct NET_NEW_RANGE_PDU {
     uint8_t type;
-    uint8_t range_start;
-    uint8_t range_end;
+    uint64_t range_start;
+    uint64_t range_end;
 };
 
 struct NET_NEW_RANGE_RESPONSE_PDU {
@@ -120,6 +143,70 @@ struct VAL_LOOKUP_RESPONSE_PDU {
     uint8_t* email;
 };
 
+/**
+ * Asks every node for the entries whose ssn starts with prefix. The node that gets it from a client sets
+ * forwarded and stop_hash to the hash before its own range, the scan is then passed on to the successor
+ * until it reaches the node responsible for stop_hash
+ */
+struct VAL_SCAN_PDU {
+    uint8_t type;
+    uint8_t prefix_length;
+    uint8_t prefix[SSN_LENGTH];
+    uint32_t sender_address;
+    uint16_t sender_port;
+    uint8_t forwarded;
+    uint64_t stop_hash;
+};
+
+/**
+ * One page of scan results from the node responsible for range_start to range_end, followed by count
+ * entries laid out as a VAL_LOOKUP_RESPONSE without the type. The last page of every node has last_page set.
+ * The hashes in VAL_SCAN and VAL_SCAN_RESPONSE are always 8 bytes so they fit any keyspace width
+ */
+struct VAL_SCAN_RESPONSE_PDU {
+    uint8_t type;
+    uint64_t range_start;
+    uint64_t range_end;
+    uint8_t last_page;
+    uint8_t count;
+};
+
+/**
+ * Many inserts in one pdu. length is the length of the whole pdu and at most VAL_INSERT_BATCH_MAX_LENGTH,
+ * it is followed by count records laid out as a VAL_INSERT without the type
+ */
+struct VAL_INSERT_BATCH_PDU {
+    uint8_t type;
+    uint16_t length;
+    uint16_t count;
+    uint8_t *records;
+};
+
+/**
+ * Looks up count ssns at once. Every node answers the ssns in its range and passes the rest on to its
+ * successor as one VAL_LOOKUP_BATCH with the same sender. length is the length of the whole pdu and at
+ * most VAL_LOOKUP_BATCH_MAX_LENGTH
+ */
+struct VAL_LOOKUP_BATCH_PDU {
+    uint8_t type;
+    uint16_t length;
+    uint16_t count;
+    uint32_t sender_address;
+    uint16_t sender_port;
+    uint8_t *ssns;
+};
+
+/**
+ * The answers of one node to a VAL_LOOKUP_BATCH, a node with many answers sends several. It is followed by
+ * count entries laid out as a status byte, 1 when the ssn was found and 0 otherwise, and a VAL_LOOKUP_RESPONSE
+ * without the type. A missing ssn has an empty name and email
+ */
+struct VAL_LOOKUP_BATCH_RESPONSE_PDU {
+    uint8_t type;
+    uint16_t length;
+    uint16_t count;
+};
+
 struct STUN_LOOKUP_PDU {
     uint8_t type;
 };
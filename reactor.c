@@ -0,0 +1,192 @@
+/**
+ * reactor.c
+ *
+ * This file represents the event loop of a node. The sockets of the node and a timer are in one edge
+ * triggered epoll set, one epoll_wait covers all of them and every ready socket is handed to its own handler
+ *
+ */
+
+#include "reactor.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define REACTOR_TIMER_SOURCE REACTOR_MAX_SOURCES
+
+/**
+ * Creates a reactor without sources
+ *
+ * @param tick the period of the timer in milliseconds
+ * @return the reactor
+ */
+reactor *reactor_create(int tick) {
+    reactor *r = calloc(1, sizeof(*r));
+
+    if(!r) {
+        perror("reactor || calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for(int i = 0; i < REACTOR_MAX_SOURCES; i++) {
+        r->sources[i].fd = -1;
+    }
+
+    r->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    r->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if(r->epollFd == -1 || r->timerFd == -1) {
+        perror("epoll_create1 || timerfd_create");
+        exit(EXIT_FAILURE);
+    }
+
+    struct itimerspec period = {};
+    period.it_interval.tv_sec = tick / 1000;
+    period.it_interval.tv_nsec = (tick % 1000) * 1000000L;
+    period.it_value = period.it_interval;
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = REACTOR_TIMER_SOURCE;
+
+    if(timerfd_settime(r->timerFd, 0, &period, NULL) == -1 || epoll_ctl(r->epollFd, EPOLL_CTL_ADD, r->timerFd, &event) == -1) {
+        perror("timerfd_settime || epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+
+    return r;
+}
+
+/**
+ * Makes fd the descriptor of a source. Nothing changes when the source already has fd, so this can be called
+ * before every wait with the current sockets. A descriptor that is closed and opened again with the same
+ * number has to be passed to reactor_forget before it is closed
+ *
+ * @param r
+ * @param source between 0 and REACTOR_MAX_SOURCES
+ * @param fd -1 leaves the source without a descriptor
+ * @param handler
+ * @param context passed to the handler
+ */
+void reactor_watch(reactor *r, int source, int fd, reactor_handler handler, void *context) {
+    reactor_source *s = &r->sources[source];
+
+    s->handler = handler;
+    s->context = context;
+
+    if(s->fd == fd) {
+        return;
+    }
+
+    if(s->fd != -1) {
+        //The old descriptor can be closed already, which took it out of the set
+        epoll_ctl(r->epollFd, EPOLL_CTL_DEL, s->fd, NULL);
+        s->fd = -1;
+        s->ready = 0;
+    }
+
+    if(fd == -1) {
+        return;
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.u32 = source;
+
+    if(epoll_ctl(r->epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("epoll_ctl || EPOLL_CTL_ADD");
+        exit(EXIT_FAILURE);
+    }
+
+    s->fd = fd;
+    s->ready = 1;
+}
+
+/**
+ * Stops waiting on a descriptor that is about to be closed
+ *
+ * @param r
+ * @param fd
+ */
+void reactor_forget(reactor *r, int fd) {
+    for(int i = 0; i < REACTOR_MAX_SOURCES; i++) {
+        if(r->sources[i].fd == fd) {
+            epoll_ctl(r->epollFd, EPOLL_CTL_DEL, fd, NULL);
+            r->sources[i].fd = -1;
+            r->sources[i].ready = 0;
+        }
+    }
+}
+
+/**
+ * Waits until a source is ready or the timer ticks. A source that is still ready from before makes this
+ * return at once
+ *
+ * @param r
+ * @param timeout in milliseconds, -1 waits for an event
+ * @return 1 if the timer ticked, 0 otherwise
+ */
+int reactor_wait(reactor *r, int timeout) {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    int ticked = 0;
+
+    for(int i = 0; i < REACTOR_MAX_SOURCES; i++) {
+        if(r->sources[i].fd != -1 && r->sources[i].ready) {
+            timeout = 0;
+        }
+    }
+
+    int count = epoll_wait(r->epollFd, events, REACTOR_MAX_EVENTS, timeout);
+
+    if(count < 0) {
+        if(errno == EINTR) {
+            return 0;
+        }
+        perror("epoll_wait");
+        exit(EXIT_FAILURE);
+    }
+
+    for(int i = 0; i < count; i++) {
+        if(events[i].data.u32 == REACTOR_TIMER_SOURCE) {
+            uint64_t expirations;
+
+            if(read(r->timerFd, &expirations, sizeof(expirations)) > 0) {
+                ticked = 1;
+            }
+            continue;
+        }
+
+        r->sources[events[i].data.u32].ready = 1;
+    }
+
+    return ticked;
+}
+
+/**
+ * Calls the handler of every ready source once, a source stays ready if its handler stopped early
+ *
+ * @param r
+ */
+void reactor_dispatch(reactor *r) {
+    for(int i = 0; i < REACTOR_MAX_SOURCES; i++) {
+        reactor_source *s = &r->sources[i];
+
+        if(s->fd != -1 && s->ready) {
+            s->ready = !s->handler(s->fd, s->context);
+        }
+    }
+}
+
+/**
+ * Closes the epoll set and the timer, the sources are left open
+ *
+ * @param r
+ */
+void reactor_destroy(reactor *r) {
+    close(r->epollFd);
+    close(r->timerFd);
+    free(r);
+}
@@ -0,0 +1,48 @@
+/**
+ * reactor.h
+ *
+ * This file represents the interface for the event loop that waits on every socket of a node at once
+ *
+ */
+
+#ifndef OU3_REACTOR_H
+#define OU3_REACTOR_H
+
+#define REACTOR_MAX_SOURCES 8
+#define REACTOR_MAX_EVENTS 16
+
+/**
+ * Reads what a ready file descriptor has, returns 1 once the descriptor has nothing more to read
+ * and 0 if it stopped early and has to be called again
+ */
+typedef int (*reactor_handler)(int fd, void *context);
+
+/**
+ * A file descriptor the reactor waits on. With edge triggered events a descriptor is only reported when
+ * new data arrives, so it stays ready until its handler has read everything
+ */
+typedef struct {
+    int fd;
+    int ready;
+    reactor_handler handler;
+    void *context;
+} reactor_source;
+
+/**
+ * A data structure representing the reactor, an epoll set over the sources and a timer that ticks
+ * every tick milliseconds so periodic work runs without traffic
+ */
+typedef struct {
+    int epollFd;
+    int timerFd;
+    reactor_source sources[REACTOR_MAX_SOURCES];
+} reactor;
+
+reactor *reactor_create(int tick);
+void reactor_watch(reactor *r, int source, int fd, reactor_handler handler, void *context);
+void reactor_forget(reactor *r, int fd);
+int reactor_wait(reactor *r, int timeout);
+void reactor_dispatch(reactor *r);
+void reactor_destroy(reactor *r);
+
+#endif //OU3_REACTOR_H
@@ -0,0 +1,241 @@
+/**
+ * receive_report.c
+ *
+ * This file represents a tool that reports the syscalls the receive path of a node makes per PDU. Bursts of
+ * VAL_LOOKUP PDUs are sent to a UDP socket and bursts of VAL_INSERT PDUs over a TCP connection, the way a
+ * client and a predecessor send them, and every burst is read with the socket_buffer receive functions the
+ * reactor calls. recv and recvfrom are wrapped below so each call, which is one syscall, is counted.
+ *
+ * Usage: receive_report [pdus]
+ *
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "pdu.h"
+#include "socket_buffer.h"
+
+#define REPORT_PDUS 100000
+#define REPORT_BURST 64
+#define REPORT_LOOKUP_LENGTH (1 + SSN_LENGTH + 4 + 2)
+#define REPORT_INSERT_LENGTH (1 + SSN_LENGTH + 1 + 16 + 1 + 24)
+#define REPORT_BUFFER (2 * VAL_INSERT_BATCH_MAX_LENGTH)
+
+static long receiveCalls = 0;
+
+ssize_t recv(int fd, void *buf, size_t len, int flags);
+ssize_t recvfrom(int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addrLen);
+static long run_datagrams(long count);
+static long run_stream(long count);
+static int send_all(int fd, const char *data, int len);
+
+/**
+ * Sends the PDUs over both kinds of socket and prints how many syscalls reading them took
+ *
+ * @param argc
+ * @param argv
+ * @return the exit status
+ */
+int main(int argc, char *argv[]) {
+    if(argc > 2) {
+        fprintf(stderr, "Usage: %s [pdus]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    long count = argc == 2 ? atol(argv[1]) : REPORT_PDUS;
+
+    if(count < 1) {
+        fprintf(stderr, "pdus has to be at least 1\n");
+        return EXIT_FAILURE;
+    }
+
+    long datagramCalls = run_datagrams(count);
+    long streamCalls = run_stream(count);
+
+    printf("receive path, %ld PDUs in bursts of %d\n", count, REPORT_BURST);
+    printf("  UDP, %d byte VAL_LOOKUP:    %.3f syscalls per PDU\n", REPORT_LOOKUP_LENGTH, (double)datagramCalls / count);
+    printf("  TCP, %d byte VAL_INSERT:    %.3f syscalls per PDU\n", REPORT_INSERT_LENGTH, (double)streamCalls / count);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Counts a recv and makes it
+ *
+ * @param fd
+ * @param buf
+ * @param len
+ * @param flags
+ * @return what the syscall returned
+ */
+ssize_t recv(int fd, void *buf, size_t len, int flags) {
+    return recvfrom(fd, buf, len, flags, NULL, NULL);
+}
+
+/**
+ * Counts a recvfrom and makes it
+ *
+ * @param fd
+ * @param buf
+ * @param len
+ * @param flags
+ * @param addr
+ * @param addrLen
+ * @return what the syscall returned
+ */
+ssize_t recvfrom(int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addrLen) {
+    receiveCalls += 1;
+    return syscall(SYS_recvfrom, fd, buf, len, flags, addr, addrLen);
+}
+
+/**
+ * Sends count VAL_LOOKUP datagrams to a UDP socket a burst at a time and reads every burst
+ *
+ * @param count
+ * @return the number of receive syscalls
+ */
+static long run_datagrams(long count) {
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(receiver == -1 || sender == -1 || bind(receiver, (struct sockaddr*)&addr, sizeof(addr)) == -1
+       || getsockname(receiver, (struct sockaddr*)&addr, &len) == -1) {
+        perror("socket || bind || getsockname");
+        exit(EXIT_FAILURE);
+    }
+
+    char pdu[REPORT_LOOKUP_LENGTH] = {VAL_LOOKUP};
+    socket_buffer b;
+    socket_buffer_create(&b, REPORT_BUFFER);
+    receiveCalls = 0;
+
+    for(long sent = 0; sent < count; ) {
+        int burst = count - sent < REPORT_BURST ? (int)(count - sent) : REPORT_BURST;
+
+        for(int i = 0; i < burst; i++) {
+            if(sendto(sender, pdu, sizeof(pdu), 0, (struct sockaddr*)&addr, sizeof(addr)) != sizeof(pdu)) {
+                perror("sendto");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        for(int read = 0; read < burst; ) {
+            socket_buffer_receive_datagrams(&b, receiver, VAL_INSERT_BATCH_MAX_LENGTH);
+
+            while(b.len >= REPORT_LOOKUP_LENGTH) {
+                socket_buffer_consume(&b, REPORT_LOOKUP_LENGTH);
+                read += 1;
+            }
+        }
+
+        sent += burst;
+    }
+
+    long calls = receiveCalls;
+
+    socket_buffer_destroy(&b);
+    close(sender);
+    close(receiver);
+
+    return calls;
+}
+
+/**
+ * Sends count VAL_INSERT PDUs over a TCP connection a burst at a time and reads every burst
+ *
+ * @param count
+ * @return the number of receive syscalls
+ */
+static long run_stream(long count) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int sender = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(listener == -1 || sender == -1 || bind(listener, (struct sockaddr*)&addr, sizeof(addr)) == -1
+       || getsockname(listener, (struct sockaddr*)&addr, &len) == -1 || listen(listener, 1) == -1
+       || connect(sender, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("socket || bind || listen || connect");
+        exit(EXIT_FAILURE);
+    }
+
+    int receiver = accept(listener, NULL, NULL);
+
+    if(receiver == -1) {
+        perror("accept");
+        exit(EXIT_FAILURE);
+    }
+
+    char pdu[REPORT_INSERT_LENGTH] = {VAL_INSERT};
+    socket_buffer b;
+    socket_buffer_create(&b, REPORT_BUFFER);
+    receiveCalls = 0;
+
+    for(long sent = 0; sent < count; ) {
+        int burst = count - sent < REPORT_BURST ? (int)(count - sent) : REPORT_BURST;
+
+        for(int i = 0; i < burst; i++) {
+            if(send_all(sender, pdu, sizeof(pdu)) == -1) {
+                perror("send");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        for(int read = 0; read < burst; ) {
+            socket_buffer_receive_stream(&b, receiver);
+
+            while(b.len >= REPORT_INSERT_LENGTH) {
+                socket_buffer_consume(&b, REPORT_INSERT_LENGTH);
+                read += 1;
+            }
+        }
+
+        sent += burst;
+    }
+
+    long calls = receiveCalls;
+
+    socket_buffer_destroy(&b);
+    close(sender);
+    close(receiver);
+    close(listener);
+
+    return calls;
+}
+
+/**
+ * Sends all of data over a stream socket
+ *
+ * @param fd
+ * @param data
+ * @param len
+ * @return 0, or -1 if a send failed
+ */
+static int send_all(int fd, const char *data, int len) {
+    while(len > 0) {
+        ssize_t result = send(fd, data, len, 0);
+
+        if(result == -1) {
+            return -1;
+        }
+
+        data += result;
+        len -= (int)result;
+    }
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+/**
+ * record_report.c
+ *
+ * This file represents a tool that reports what the records of a table cost. It fills a table with generated
+ * people whose names and email domains repeat the way real ones do, prints the resident memory the records
+ * added and times inserting them one by one and in batches and looking every one of them up, which is where
+ * RECORD_DICTIONARY pays for decoding. Build it with and without RECORD_DICTIONARY to compare.
+ *
+ * Usage: record_report [records]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hash_table.h"
+
+#define REPORT_RECORDS 1000000
+#define REPORT_ROUNDS 5
+#define REPORT_FIRST_NAMES 300
+#define REPORT_LAST_NAMES 1000
+
+static const char *syllables[] = {
+        "an", "be", "ca", "da", "el", "fi", "ga", "ha", "is", "jo", "ka", "li", "ma", "ni", "ol",
+        "pe", "ra", "sa", "te", "ul", "vi", "wi", "yl", "ze", "ber", "dor", "gren", "lund", "ström", "vik"
+};
+
+static const char *domains[] = {
+        "gmail.com", "hotmail.com", "outlook.com", "yahoo.com", "icloud.com", "student.umu.se", "telia.com", "live.se"
+};
+
+/**
+ * A generated record
+ */
+typedef struct {
+    char ssn[SSN_LENGTH + 1];
+    char name[64];
+    char email[128];
+} report_record;
+
+static int make_batch(long first, long count, report_record *batch, hash_table_record *records);
+static void make_record(long i, report_record *record);
+static void make_word(long seed, int syllableCount, char *out);
+static long resident_bytes(void);
+static double elapsed(const struct timespec *start);
+
+/**
+ * Fills a table with generated records and prints their memory and lookup cost
+ *
+ * @param argc
+ * @param argv
+ * @return the exit status
+ */
+int main(int argc, char *argv[]) {
+    if(argc > 2) {
+        fprintf(stderr, "Usage: %s [records]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    long count = argc == 2 ? atol(argv[1]) : REPORT_RECORDS;
+
+    if(count < 1) {
+        fprintf(stderr, "records has to be at least 1\n");
+        return EXIT_FAILURE;
+    }
+
+    report_record *batch = malloc(HASH_TABLE_BATCH * sizeof(*batch));
+    hash_table_record records[HASH_TABLE_BATCH];
+    int statuses[HASH_TABLE_BATCH];
+    size_t fieldBytes = 0;
+    double insertTime = 0;
+
+    long before = resident_bytes();
+    hash_table *table = hash_table_create(0, HASH_MAX);
+    struct timespec start;
+
+    //Records are generated a batch at a time so only the inserts are timed
+    for(long i = 0; i < count; i += HASH_TABLE_BATCH) {
+        int len = make_batch(i, count, batch, records);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for(int j = 0; j < len; j++) {
+            hash_table_insert(table, records[j].ssn, records[j].name, records[j].nameLength, records[j].email, records[j].emailLength);
+            fieldBytes += 2 + records[j].nameLength + records[j].emailLength;
+        }
+
+        insertTime += elapsed(&start);
+    }
+
+    long after = resident_bytes();
+
+    printf("RECORD_DICTIONARY %d, RECORD_WIRE %d, %ld records\n", RECORD_DICTIONARY, RECORD_WIRE, count);
+    printf("  name and email bytes:   %zu\n", fieldBytes);
+    printf("  resident growth:        %.1f MiB, %.1f MiB per million records\n",
+           (after - before) / 1048576.0, (after - before) / 1048576.0 * 1000000 / count);
+
+    dictionary_stats stats;
+    dictionary_get_stats(&stats);
+    printf("  dictionary:             %ld codes, %zu bytes\n", stats.codes, stats.bytes);
+    printf("  insert:                 %.1f ns per record\n", insertTime * 1e9 / count);
+
+    hash_table_entry entry;
+    report_record record;
+    long wrong = 0;
+
+    for(long i = 0; i < count; i++) {
+        make_record(i, &record);
+        hash_table_lookup(table, record.ssn, &entry);
+
+        if(!entry.name || entry.nameLength != strlen(record.name) || memcmp(entry.name, record.name, entry.nameLength) != 0
+           || entry.emailLength != strlen(record.email) || memcmp(entry.email, record.email, entry.emailLength) != 0) {
+            wrong += 1;
+        }
+    }
+
+    char (*ssns)[SSN_LENGTH] = malloc(count * SSN_LENGTH);
+
+    for(long i = 0; i < count; i++) {
+        make_record(i, &record);
+        memcpy(ssns[i], record.ssn, SSN_LENGTH);
+    }
+
+    double best = 0;
+    unsigned long sum = 0;
+
+    for(int round = 0; round < REPORT_ROUNDS; round++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for(long i = 0; i < count; i++) {
+            hash_table_lookup(table, ssns[i], &entry);
+            sum += entry.nameLength + entry.emailLength;
+        }
+
+        double time = elapsed(&start);
+        best = round == 0 || time < best ? time : best;
+    }
+
+    printf("  lookup:                 %.1f ns per record, best of %d (%lu)\n", best * 1e9 / count, REPORT_ROUNDS, sum);
+
+    hash_table *batched = hash_table_create(0, HASH_MAX);
+    double batchTime = 0;
+
+    for(long i = 0; i < count; i += HASH_TABLE_BATCH) {
+        int len = make_batch(i, count, batch, records);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        hash_table_insert_batch(batched, records, len, statuses);
+        batchTime += elapsed(&start);
+    }
+
+    printf("  batch insert:           %.1f ns per record, %d records per batch\n", batchTime * 1e9 / count, HASH_TABLE_BATCH);
+
+    free(batch);
+    hash_table_destroy(batched);
+
+    printf("  wrong after decoding:   %ld\n", wrong);
+
+    free(ssns);
+    hash_table_destroy(table);
+
+    return wrong == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Generates the records from first on, at most HASH_TABLE_BATCH of them and none past count
+ *
+ * @param first
+ * @param count
+ * @param batch filled with the records
+ * @param records filled with views of the records for the table
+ * @return the number of records generated
+ */
+static int make_batch(long first, long count, report_record *batch, hash_table_record *records) {
+    int len = count - first < HASH_TABLE_BATCH ? (int)(count - first) : HASH_TABLE_BATCH;
+
+    for(int i = 0; i < len; i++) {
+        make_record(first + i, &batch[i]);
+        records[i] = (hash_table_record){batch[i].ssn, batch[i].name, batch[i].email, strlen(batch[i].name), strlen(batch[i].email)};
+    }
+
+    return len;
+}
+
+/**
+ * Generates record number i. The ssns are unique, first and last names are drawn from fixed pools and
+ * the email is made from the name, a number and one of a few domains
+ *
+ * @param i
+ * @param record
+ */
+static void make_record(long i, report_record *record) {
+    uint64_t mix = (uint64_t)i * 0x9e3779b97f4a7c15ULL;
+    mix ^= mix >> 29;
+
+    char first[32];
+    char last[32];
+
+    make_word((long)(mix % REPORT_FIRST_NAMES), 2, first);
+    make_word(1000 + (long)((mix >> 16) % REPORT_LAST_NAMES), 3, last);
+
+    snprintf(record->ssn, sizeof(record->ssn), "%012llu", (unsigned long long)(((uint64_t)i * 2654435761ULL) % 1000000000000ULL));
+    snprintf(record->name, sizeof(record->name), "%s %s", first, last);
+    snprintf(record->email, sizeof(record->email), "%s.%s%d@%s", first, last, (int)((mix >> 32) % 100),
+             domains[(mix >> 40) % (sizeof(domains) / sizeof(domains[0]))]);
+}
+
+/**
+ * Builds a capitalised word from syllables
+ *
+ * @param seed
+ * @param syllableCount
+ * @param out
+ */
+static void make_word(long seed, int syllableCount, char *out) {
+    int syllableTotal = sizeof(syllables) / sizeof(syllables[0]);
+
+    out[0] = '\0';
+
+    for(int i = 0; i < syllableCount; i++) {
+        strcat(out, syllables[seed % syllableTotal]);
+        seed = seed / syllableTotal + seed * 7 + i;
+    }
+
+    if(out[0] >= 'a' && out[0] <= 'z') {
+        out[0] -= 'a' - 'A';
+    }
+}
+
+/**
+ * Returns the resident memory of the process
+ *
+ * @return the number of bytes
+ */
+static long resident_bytes(void) {
+    long pages = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+
+    if(file) {
+        if(fscanf(file, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(file);
+    }
+
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Returns the seconds since start
+ *
+ * @param start
+ * @return the seconds
+ */
+static double elapsed(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
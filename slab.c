@@ -0,0 +1,115 @@
+/**
+ * slab.c
+ *
+ * This file represents the implementation of the slab allocator. Allocations are bumped out of chunks that
+ * double in size up to SLAB_MAX_CHUNK and are only given back to the system all at once by slab_release.
+ *
+ */
+
+#include "slab.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int slab_class(size_t size);
+
+/**
+ * Returns how many bytes an allocation of size bytes takes up in the slab
+ *
+ * @param size
+ * @return the size of the size class
+ */
+size_t slab_size(size_t size) {
+    return (size_t)(slab_class(size) + 1) * SLAB_GRANULARITY;
+}
+
+/**
+ * Allocates size bytes from the slab, size can be at most SLAB_MAX_ALLOCATION
+ *
+ * @param s
+ * @param size
+ * @return a pointer to the allocation
+ */
+void *slab_alloc(slab *s, size_t size) {
+    int class = slab_class(size);
+    size_t classSize = slab_size(size);
+
+    if(s->freeLists[class]) {
+        void *ptr = s->freeLists[class];
+        s->freeLists[class] = *(void**)ptr;
+        return ptr;
+    }
+
+    if(!s->chunks || s->chunks->size - s->chunks->used < classSize) {
+        size_t chunkSize = SLAB_MIN_CHUNK;
+
+        if(s->chunks) {
+            chunkSize = s->chunks->size * 2 > SLAB_MAX_CHUNK ? SLAB_MAX_CHUNK : s->chunks->size * 2;
+        }
+
+        slab_chunk *chunk = malloc(sizeof(*chunk) + chunkSize);
+
+        if(!chunk) {
+            perror("slab_chunk || malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        chunk->next = s->chunks;
+        chunk->size = chunkSize;
+        chunk->used = 0;
+        s->chunks = chunk;
+    }
+
+    void *ptr = s->chunks->data + s->chunks->used;
+    s->chunks->used += classSize;
+
+    return ptr;
+}
+
+/**
+ * Gives an allocation back to the slab so it can be reused by an allocation of the same size class
+ *
+ * @param s
+ * @param ptr
+ * @param size the size that was passed to slab_alloc
+ */
+void slab_free(slab *s, void *ptr, size_t size) {
+    int class = slab_class(size);
+
+    *(void**)ptr = s->freeLists[class];
+    s->freeLists[class] = ptr;
+}
+
+/**
+ * Frees every chunk of the slab at once, all allocations from it become invalid
+ *
+ * @param s
+ */
+void slab_release(slab *s) {
+    slab_chunk *chunk = s->chunks;
+
+    while(chunk) {
+        slab_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    s->chunks = NULL;
+
+    for(int i = 0; i < SLAB_CLASSES; i++) {
+        s->freeLists[i] = NULL;
+    }
+}
+
+/**
+ * Returns the size class for an allocation size
+ *
+ * @param size
+ * @return the size class
+ */
+static int slab_class(size_t size) {
+    if(size < sizeof(void*)) {
+        size = sizeof(void*);
+    }
+
+    return (int)((size + SLAB_GRANULARITY - 1) / SLAB_GRANULARITY) - 1;
+}
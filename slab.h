@@ -0,0 +1,42 @@
+/**
+ * slab.h
+ *
+ * This file represents the interface for the slab allocator that hash table records are carved from
+ *
+ */
+
+#ifndef OU3_SLAB_H
+#define OU3_SLAB_H
+
+#include <stddef.h>
+
+#define SLAB_GRANULARITY 16
+#define SLAB_MAX_ALLOCATION 528
+#define SLAB_CLASSES (SLAB_MAX_ALLOCATION / SLAB_GRANULARITY)
+#define SLAB_MIN_CHUNK 1024
+#define SLAB_MAX_CHUNK 65536
+
+/**
+ * A chunk of memory that allocations are bumped from
+ */
+typedef struct slab_chunk {
+    struct slab_chunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+} slab_chunk;
+
+/**
+ * A data structure representing the slab, freed allocations are kept in one free list per size class
+ */
+typedef struct {
+    slab_chunk *chunks;
+    void *freeLists[SLAB_CLASSES];
+} slab;
+
+size_t slab_size(size_t size);
+void *slab_alloc(slab *s, size_t size);
+void slab_free(slab *s, void *ptr, size_t size);
+void slab_release(slab *s);
+
+#endif //OU3_SLAB_H
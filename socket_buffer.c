@@ -0,0 +1,137 @@
+/**
+ * socket_buffer.c
+ *
+ * This file represents the buffers the sockets of a node are read into. The memory of a buffer is one
+ * memfd mapped twice back to back, so the unread bytes are contiguous wherever the ring wraps and the
+ * parsers read them in place
+ *
+ */
+
+#define _GNU_SOURCE
+#include "socket_buffer.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+/**
+ * Creates an empty buffer
+ *
+ * @param b
+ * @param capacity rounded up to whole pages
+ */
+void socket_buffer_create(socket_buffer *b, int capacity) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = (size_t)((capacity + page - 1) / page * page);
+
+    int fd = memfd_create("socket_buffer", MFD_CLOEXEC);
+
+    if(fd == -1 || ftruncate(fd, (off_t)size) == -1) {
+        perror("memfd_create || ftruncate");
+        exit(EXIT_FAILURE);
+    }
+
+    //Reserve both halves first so the second mapping lands right after the first
+    char *base = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(base == MAP_FAILED
+       || mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+       || mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        perror("mmap || socket_buffer");
+        exit(EXIT_FAILURE);
+    }
+
+    close(fd);
+
+    b->base = base;
+    b->buffer = base;
+    b->len = 0;
+    b->capacity = (int)size;
+}
+
+/**
+ * Drops bytes from the start of the buffer
+ *
+ * @param b
+ * @param bytes at most len
+ */
+void socket_buffer_consume(socket_buffer *b, int bytes) {
+    b->buffer += bytes;
+    b->len -= bytes;
+
+    if(b->buffer >= b->base + b->capacity) {
+        b->buffer -= b->capacity;
+    }
+}
+
+/**
+ * Reads the datagrams waiting on a socket straight into the free space, one syscall each. A datagram that
+ * does not fit is cut off by the kernel, so reading stops while there is room for less than the longest one
+ *
+ * @param b
+ * @param fd
+ * @param datagramMax the length of the longest datagram
+ * @return 1 if the socket has nothing more to read, 0 if the buffer filled up first
+ */
+int socket_buffer_receive_datagrams(socket_buffer *b, int fd, int datagramMax) {
+    while(b->capacity - b->len >= datagramMax) {
+        ssize_t result = recvfrom(fd, b->buffer + b->len, b->capacity - b->len, MSG_DONTWAIT, NULL, NULL);
+
+        if(result == -1) {
+            if(errno == EWOULDBLOCK || errno == ENOTCONN) {
+                return 1;
+            }
+            perror("UDP_READ");
+            exit(EXIT_FAILURE);
+        }
+
+        b->len += (int)result;
+    }
+
+    return 0;
+}
+
+/**
+ * Reads what a stream socket has straight into the free space, a PDU that is cut off stays in the buffer
+ * until the rest of it arrives. A read that returns less than there was room for emptied the socket, so
+ * no extra read is made to see EWOULDBLOCK
+ *
+ * @param b
+ * @param fd
+ * @return 1 if the socket has nothing more to read or is closed, 0 if the buffer filled up first
+ */
+int socket_buffer_receive_stream(socket_buffer *b, int fd) {
+    while(b->len < b->capacity) {
+        int room = b->capacity - b->len;
+        ssize_t result = recv(fd, b->buffer + b->len, room, MSG_DONTWAIT);
+
+        if(result == -1) {
+            if(errno == EWOULDBLOCK || errno == ENOTCONN) {
+                return 1;
+            }
+            perror("TCP_READ");
+            exit(EXIT_FAILURE);
+        }
+
+        b->len += (int)result;
+
+        if(result < room) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Unmaps the buffer
+ *
+ * @param b
+ */
+void socket_buffer_destroy(socket_buffer *b) {
+    munmap(b->base, 2 * (size_t)b->capacity);
+    b->base = NULL;
+    b->buffer = NULL;
+}
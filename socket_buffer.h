@@ -0,0 +1,29 @@
+/**
+ * socket_buffer.h
+ *
+ * This file represents the interface for the buffers the sockets of a node are read into
+ *
+ */
+
+#ifndef OU3_SOCKET_BUFFER_H
+#define OU3_SOCKET_BUFFER_H
+
+/**
+ * The data structure for the socket buffer, a ring whose memory is mapped twice in a row. buffer points at
+ * the first unread byte, the len unread bytes can be read and capacity - len bytes written after them
+ * without ever wrapping, and consuming bytes only moves buffer
+ */
+typedef struct {
+    char *buffer;
+    int len;
+    int capacity;
+    char *base;
+} socket_buffer;
+
+void socket_buffer_create(socket_buffer *b, int capacity);
+void socket_buffer_consume(socket_buffer *b, int bytes);
+int socket_buffer_receive_datagrams(socket_buffer *b, int fd, int datagramMax);
+int socket_buffer_receive_stream(socket_buffer *b, int fd);
+void socket_buffer_destroy(socket_buffer *b);
+
+#endif //OU3_SOCKET_BUFFER_H
@@ -0,0 +1,255 @@
+/**
+ * ssn_index.c
+ *
+ * This file represents the implementation of the ordered ssn index. Inserts are appended to a pending run
+ * which is sorted and merged into the main run once it has grown to an eighth of it, so an insert costs
+ * amortized O(log n) and a range scan is a binary search followed by a sequential walk.
+ * Ssns that are not 12 digits have no order and are never indexed.
+ *
+ */
+
+#include "ssn_index.h"
+#include <stdio.h>
+
+static int ssn_index_contains(hash_table *table, uint64_t key, hash_table_entry *entry);
+static int compare_keys(const void *a, const void *b);
+
+/**
+ * Creates an empty index
+ *
+ * @return the index pointer
+ */
+ssn_index *ssn_index_create(void) {
+    ssn_index *index = calloc(1, sizeof(*index));
+
+    if(!index) {
+        perror("index || calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    return index;
+}
+
+/**
+ * Frees the index
+ *
+ * @param index
+ */
+void ssn_index_destroy(ssn_index *index) {
+    free(index->keys);
+    free(index->pending);
+    free(index);
+}
+
+/**
+ * Adds an ssn that was inserted into the table to the index, inserting the same ssn again is fine
+ *
+ * @param index
+ * @param table the table the ssn was inserted into
+ * @param ssn
+ */
+void ssn_index_add(ssn_index *index, hash_table *table, const char *ssn) {
+    uint64_t key = ssn_pack(ssn);
+
+    if(key & SSN_KEY_RAW) {
+        return;
+    }
+
+    if(index->pendingLength == index->pendingCapacity) {
+        index->pendingCapacity = index->pendingCapacity == 0 ? SSN_INDEX_MIN_CAPACITY : index->pendingCapacity * 2;
+        index->pending = realloc(index->pending, index->pendingCapacity * sizeof(*index->pending));
+
+        if(!index->pending) {
+            perror("index->pending || realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    index->pending[index->pendingLength] = key;
+    index->pendingLength += 1;
+
+    if(index->pendingLength >= SSN_INDEX_MIN_MERGE && index->pendingLength * 8 >= index->length) {
+        ssn_index_merge(index, table);
+    }
+}
+
+/**
+ * Adds every entry of the table to the index
+ *
+ * @param index
+ * @param table
+ */
+void ssn_index_build(ssn_index *index, hash_table *table) {
+    int span = hash_table_get_bucket_count(table);
+    hash_table_entry entry;
+
+    for(int i = 0; i < span; i++) {
+        bucket *b = &table->buckets[i];
+
+        for(int j = hash_table_bucket_next(b, 0, &entry); j >= 0; j = hash_table_bucket_next(b, j + 1, &entry)) {
+            ssn_index_add(index, table, entry.ssn);
+        }
+    }
+
+    ssn_index_merge(index, table);
+}
+
+/**
+ * Sorts the pending run and merges it into the main run. Duplicates and keys that are no longer in
+ * the table are dropped
+ *
+ * @param index
+ * @param table
+ */
+void ssn_index_merge(ssn_index *index, hash_table *table) {
+    qsort(index->pending, index->pendingLength, sizeof(*index->pending), compare_keys);
+
+    int capacity = index->length + index->pendingLength;
+    uint64_t *keys = malloc((capacity > 0 ? capacity : 1) * sizeof(*keys));
+
+    if(!keys) {
+        perror("keys || malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    hash_table_entry entry;
+    int length = 0;
+    int i = 0;
+    int j = 0;
+
+    while(i < index->length || j < index->pendingLength) {
+        uint64_t key;
+
+        if(j == index->pendingLength || (i < index->length && index->keys[i] < index->pending[j])) {
+            key = index->keys[i++];
+        } else {
+            key = index->pending[j++];
+        }
+
+        if((length > 0 && keys[length - 1] == key) || !ssn_index_contains(table, key, &entry)) {
+            continue;
+        }
+
+        keys[length] = key;
+        length += 1;
+    }
+
+    free(index->keys);
+    index->keys = keys;
+    index->length = length;
+    index->capacity = capacity;
+    index->pendingLength = 0;
+}
+
+/**
+ * Turns an ssn prefix into the range of packed keys that start with it
+ *
+ * @param prefix
+ * @param length the number of prefix digits, 0 matches every ssn
+ * @param first the smallest key with the prefix
+ * @param last the largest key with the prefix
+ * @return 0 or -1 if the prefix is not made of at most 12 digits
+ */
+int ssn_index_prefix_range(const char *prefix, int length, uint64_t *first, uint64_t *last) {
+    if(length < 0 || length > SSN_LENGTH) {
+        return -1;
+    }
+
+    uint64_t key = 0;
+    uint64_t width = 1;
+
+    for(int i = 0; i < SSN_LENGTH; i++) {
+        if(i < length) {
+            if(prefix[i] < '0' || prefix[i] > '9') {
+                return -1;
+            }
+            key = key * 10 + (uint64_t)(prefix[i] - '0');
+        } else {
+            key *= 10;
+            width *= 10;
+        }
+    }
+
+    *first = key;
+    *last = key + width - 1;
+
+    return 0;
+}
+
+/**
+ * Scans the entries with keys between next and last in ssn order. Pending keys are merged first.
+ * The entries are views into the table and are only valid until the table is changed
+ *
+ * @param index
+ * @param table
+ * @param next the first key to scan, it is moved past the scanned keys and is larger than last when the scan is done
+ * @param last the last key to scan
+ * @param entries filled with the entries found
+ * @param max the size of entries
+ * @return the number of entries found
+ */
+int ssn_index_scan(ssn_index *index, hash_table *table, uint64_t *next, uint64_t last, hash_table_entry *entries, int max) {
+    if(index->pendingLength > 0) {
+        ssn_index_merge(index, table);
+    }
+
+    int lo = 0;
+    int hi = index->length;
+
+    while(lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if(index->keys[mid] < *next) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    int found = 0;
+
+    for(int i = lo; i < index->length && index->keys[i] <= last; i++) {
+        if(found == max) {
+            *next = index->keys[i];
+            return found;
+        }
+
+        if(ssn_index_contains(table, index->keys[i], &entries[found])) {
+            found += 1;
+        }
+    }
+
+    *next = last + 1;
+
+    return found;
+}
+
+/**
+ * Looks up a packed key in the table
+ *
+ * @param table
+ * @param key a packed digit ssn
+ * @param entry filled with the entry if it is found
+ * @return 1 if the table has the key, 0 otherwise
+ */
+static int ssn_index_contains(hash_table *table, uint64_t key, hash_table_entry *entry) {
+    char ssn[SSN_LENGTH];
+
+    ssn_unpack(key, ssn);
+
+    return hash_table_contains(table, ssn, entry);
+}
+
+/**
+ * Compares two packed keys for qsort
+ *
+ * @param a
+ * @param b
+ * @return less than, equal to or greater than zero
+ */
+static int compare_keys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,38 @@
+/**
+ * ssn_index.h
+ *
+ * This file represents the interface for the ordered ssn index that is kept next to the hash table
+ *
+ */
+
+#ifndef OU3_SSN_INDEX_H
+#define OU3_SSN_INDEX_H
+
+#include "hash_table.h"
+
+#define SSN_INDEX_MIN_MERGE 1024
+#define SSN_INDEX_MIN_CAPACITY 64
+
+/**
+ * A data structure representing the index. It holds the packed keys of digit ssns in one sorted run and
+ * a pending run of keys inserted since the last merge. Removed entries are not taken out of the index,
+ * they are skipped by scans and dropped the next time the runs are merged
+ */
+typedef struct {
+    uint64_t *keys;
+    int length;
+    int capacity;
+    uint64_t *pending;
+    int pendingLength;
+    int pendingCapacity;
+} ssn_index;
+
+ssn_index *ssn_index_create(void);
+void ssn_index_destroy(ssn_index *index);
+void ssn_index_add(ssn_index *index, hash_table *table, const char *ssn);
+void ssn_index_build(ssn_index *index, hash_table *table);
+void ssn_index_merge(ssn_index *index, hash_table *table);
+int ssn_index_prefix_range(const char *prefix, int length, uint64_t *first, uint64_t *last);
+int ssn_index_scan(ssn_index *index, hash_table *table, uint64_t *next, uint64_t last, hash_table_entry *entries, int max);
+
+#endif //OU3_SSN_INDEX_H
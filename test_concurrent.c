@@ -0,0 +1,227 @@
+/**
+ * test_concurrent.c
+ *
+ * This file represents the test of the concurrent lookup path, see HASH_CONCURRENT. Reader threads look up
+ * ssns with hash_table_lookup_concurrent inside their epochs while the writer keeps inserting, removing,
+ * compacting and detaching and regrowing the top of the range the way the node does. A stable ssn in the
+ * part of the range that is never detached always has to be found with its own name, any other ssn may be
+ * missing but never found with the wrong record. Build and run it with make test_concurrent, it is built
+ * with ASan and UBSan so a read of freed memory fails the test as well
+ *
+ * Usage: test_concurrent [rounds]
+ *
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "epoch.h"
+#include "hash_table.h"
+
+#if !HASH_CONCURRENT
+#error "test_concurrent needs HASH_CONCURRENT"
+#endif
+
+#define TEST_STABLE 20000
+#define TEST_READERS 3
+#define TEST_ROUNDS 20
+#define TEST_COMPACT_BUDGET 256
+
+/**
+ * A reader thread and what it has seen
+ */
+typedef struct {
+    pthread_t thread;
+    unsigned int seed;
+    long found;
+    long wrong;
+} test_reader;
+
+static hash_table *table;
+static int stop = 0;
+static hash_t detachedMin;
+
+static void *read_entries(void *arg);
+static int check_found(const hash_table_entry *entry, const char *ssn, const char *prefix, int number);
+static void churn(int round);
+static void make_ssn(int i, char *ssn);
+
+/**
+ * Starts the readers, runs the writer and reports what the readers saw
+ *
+ * @param argc
+ * @param argv
+ * @return the exit status, a failure if any reader saw a wrong record
+ */
+int main(int argc, char *argv[]) {
+    if(argc > 2) {
+        fprintf(stderr, "Usage: %s [rounds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int rounds = argc == 2 ? atoi(argv[1]) : TEST_ROUNDS;
+    test_reader readers[TEST_READERS] = {};
+    char ssn[SSN_LENGTH + 1];
+    char name[32];
+
+    table = hash_table_create(0, HASH_MAX);
+    detachedMin = HASH_MAX / 4 * 3 + 1;
+
+    for(int i = 0; i < TEST_STABLE; i++) {
+        make_ssn(3 * i, ssn);
+        hash_table_insert(table, ssn, name, snprintf(name, sizeof(name), "Stable%d", 3 * i), "stable@x.se", 11);
+    }
+
+    for(int i = 0; i < TEST_READERS; i++) {
+        readers[i].seed = 7919 * i + 1;
+        assert(pthread_create(&readers[i].thread, NULL, read_entries, &readers[i]) == 0);
+    }
+
+    for(int round = 0; round < rounds; round++) {
+        churn(round);
+    }
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+
+    long found = 0;
+    long wrong = 0;
+
+    for(int i = 0; i < TEST_READERS; i++) {
+        pthread_join(readers[i].thread, NULL);
+        found += readers[i].found;
+        wrong += readers[i].wrong;
+    }
+
+    epoch_synchronize();
+    hash_table_destroy(table);
+    epoch_collect();
+
+    printf("test_concurrent: %d rounds, %d readers found %ld stable entries, %ld wrong, %ld retired left\n",
+           rounds, TEST_READERS, found, wrong, epoch_pending());
+
+    return wrong == 0 && found > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Looks up random stable ssns and the churned ssn after each of them until the writer is done
+ *
+ * @param arg the test_reader
+ * @return NULL
+ */
+static void *read_entries(void *arg) {
+    test_reader *reader = arg;
+    int epochReader = epoch_register();
+    uint8_t record[HASH_TABLE_RECORD_MAX];
+    hash_table_entry entry;
+    char ssn[SSN_LENGTH + 1];
+
+    while(!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+        int i = 3 * (int)(rand_r(&reader->seed) % TEST_STABLE);
+
+        make_ssn(i, ssn);
+        epoch_enter(epochReader);
+        int status = hash_table_lookup_concurrent(table, ssn, &entry, record);
+        epoch_exit(epochReader);
+
+        //Only the top of the range is ever detached, everything below it has to be found every time
+        if(hash_ssn(ssn) < detachedMin) {
+            if(status != 0 || !check_found(&entry, ssn, "Stable", i)) {
+                reader->wrong += 1;
+            } else {
+                reader->found += 1;
+            }
+        } else if(status == 0 && entry.name && !check_found(&entry, ssn, "Stable", i)) {
+            reader->wrong += 1;
+        }
+
+        make_ssn(i + 1, ssn);
+        epoch_enter(epochReader);
+        status = hash_table_lookup_concurrent(table, ssn, &entry, record);
+        epoch_exit(epochReader);
+
+        if(status == 0 && entry.name && !check_found(&entry, ssn, "Churn", i + 1)) {
+            reader->wrong += 1;
+        }
+    }
+
+    epoch_unregister(epochReader);
+
+    return NULL;
+}
+
+/**
+ * Checks that an entry was found and is the record of an ssn
+ *
+ * @param entry
+ * @param ssn
+ * @param prefix of the name the record was inserted with
+ * @param number of the ssn
+ * @return 1 if it is, 0 otherwise
+ */
+static int check_found(const hash_table_entry *entry, const char *ssn, const char *prefix, int number) {
+    char name[32];
+    int nameLength = snprintf(name, sizeof(name), "%s%d", prefix, number);
+
+    return entry->name && memcmp(entry->ssn, ssn, SSN_LENGTH) == 0
+           && entry->nameLength == nameLength && memcmp(entry->name, name, nameLength) == 0;
+}
+
+/**
+ * One round of the writer. The churned ssns are inserted and removed again, the tombstones compacted away
+ * and the top of the range is detached, handed off and grown back with its stable entries
+ *
+ * @param round
+ */
+static void churn(int round) {
+    char ssn[SSN_LENGTH + 1];
+    char name[32];
+
+    for(int i = 0; i < TEST_STABLE; i++) {
+        make_ssn(3 * i + 1, ssn);
+        hash_table_insert(table, ssn, name, snprintf(name, sizeof(name), "Churn%d", 3 * i + 1), "churn@x.se", 10);
+    }
+
+    for(int i = 0; i < TEST_STABLE; i++) {
+        make_ssn(3 * i + 1, ssn);
+        hash_table_remove(table, ssn);
+    }
+
+    while(hash_table_compact(table, TEST_COMPACT_BUDGET) > 0);
+
+    hash_table *detached = hash_table_detach_range(table, detachedMin, HASH_MAX);
+    assert(detached);
+
+    //Like the node, the detached table is only destroyed once no reader can be using it
+    epoch_synchronize();
+    hash_table_destroy(detached);
+
+    hash_table_resize(table, 0, HASH_MAX);
+
+    for(int i = 0; i < TEST_STABLE; i++) {
+        make_ssn(3 * i, ssn);
+
+        if(hash_ssn(ssn) >= detachedMin) {
+            hash_table_insert(table, ssn, name, snprintf(name, sizeof(name), "Stable%d", 3 * i), "stable@x.se", 11);
+        }
+    }
+
+    if(round % 5 == 0) {
+        epoch_collect();
+    }
+}
+
+/**
+ * Generates ssn number i, every seventh one has letters in it so it is stored as a raw key
+ *
+ * @param i
+ * @param ssn at least SSN_LENGTH + 1 bytes
+ */
+static void make_ssn(int i, char *ssn) {
+    snprintf(ssn, SSN_LENGTH + 1, "%012lld", 190001010000LL + (long long)i * 7919);
+
+    if(i % 7 == 0) {
+        ssn[4] = (char)('a' + i % 26);
+    }
+}
@@ -1,35 +1,588 @@
+/**
+ * test_hash.c
+ *
+ * This file represents the tests of the hash table. Every test fills its own table from the same generated
+ * ssns and checks every one of them against what it should hold, build and run them with make test
+ *
+ */
+
+#include <assert.h>
 #include <stdio.h>
+#include <unistd.h>
 #include "hash.h"
 #include "hash_table.h"
 
+#define TEST_ENTRIES 5000
+#define TEST_FILE "test_hash.tbl"
+#define TEST_COPY "test_hash_copy.tbl"
+
+static void test_insert_remove(void);
+static void test_resize(void);
+static void test_detach_range(void);
+static void test_tombstones(void);
+static void test_compact(void);
+static void test_filter_stats(void);
+static void test_save_open(void);
+static void test_open_corrupt(void);
+static hash_table *fill(hash_t min, hash_t max, int *versions);
+static void check_entries(hash_table *table, const int *versions);
+static long count_entries(hash_table *table);
+static long count_tombstones(hash_table *table);
+static long count_capacity(hash_table *table);
+static long count_in_range(hash_t min, hash_t max, const int *versions);
+static void make_ssn(int i, char *ssn);
+static int make_name(int i, int version, char *name);
+static int make_email(int i, char *email);
+static long read_file(const char *path, uint8_t **bytes);
+static void write_file(const char *path, const uint8_t *bytes, long size);
+
+/**
+ * Runs the tests, a failing check aborts with the line it failed on
+ *
+ * @return the exit status
+ */
 int main(void) {
-    //char *ssn = "aaaaabbbbbcc";
-    //printf("%d", hash_ssn(ssn));
+    test_insert_remove();
+    test_resize();
+    test_detach_range();
+    test_tombstones();
+    test_compact();
+    test_filter_stats();
+    test_save_open();
+    test_open_corrupt();
+
+    printf("test_hash: all tests passed\n");
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Inserts, replaces and removes entries of a table over the whole keyspace
+ */
+static void test_insert_remove(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(0, HASH_MAX, versions);
+    char ssn[SSN_LENGTH + 1];
+    char name[32];
+    char email[32];
+
+    check_entries(table, versions);
+    assert(count_entries(table) == TEST_ENTRIES);
+
+    for(int i = 0; i < TEST_ENTRIES; i += 3) {
+        make_ssn(i, ssn);
+        versions[i] = 2;
+        assert(hash_table_insert(table, ssn, name, make_name(i, 2, name), email, make_email(i, email)) == 0);
+    }
+
+    for(int i = 0; i < TEST_ENTRIES; i += 4) {
+        make_ssn(i, ssn);
+        versions[i] = 0;
+        assert(hash_table_remove(table, ssn) == 0);
+    }
+
+    check_entries(table, versions);
+    assert(count_entries(table) == count_in_range(0, HASH_MAX, versions));
+
+    hash_table_destroy(table);
+}
+
+/**
+ * Shrinks and grows the range of a table, entries outside the new range are dropped and the rest stay
+ */
+static void test_resize(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(0, HASH_MAX, versions);
+    hash_t min = HASH_MAX / 8;
+    hash_t max = HASH_MAX / 8 * 5 + 3;
+
+    table = hash_table_resize(table, min, max);
+
+    for(int i = 0; i < TEST_ENTRIES; i++) {
+        char ssn[SSN_LENGTH + 1];
+        make_ssn(i, ssn);
+
+        if(hash_ssn(ssn) < min || hash_ssn(ssn) > max) {
+            versions[i] = 0;
+        }
+    }
+
+    assert(table->minHash == min && table->maxHash == max);
+    check_entries(table, versions);
+    assert(count_entries(table) == count_in_range(min, max, versions));
+
+    table = hash_table_resize(table, 0, HASH_MAX);
+    check_entries(table, versions);
+    assert(count_entries(table) == count_in_range(0, HASH_MAX, versions));
+
+    hash_table_destroy(table);
+}
+
+/**
+ * Detaches the top and the bottom of a table, every entry ends up in exactly one of the tables. The
+ * bounds are picked inside buckets so a keyspace wider than 8 bits also splits a bucket
+ */
+static void test_detach_range(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(0, HASH_MAX, versions);
+    long total = count_in_range(0, HASH_MAX, versions);
+    hash_t split = HASH_MAX / 4 * 3 + 1;
+
+    assert(hash_table_detach_range(table, HASH_MAX / 4, HASH_MAX / 2) == NULL);
+    assert(hash_table_detach_range(table, 0, HASH_MAX) == NULL);
+
+    hash_table *upper = hash_table_detach_range(table, split, HASH_MAX);
+
+    assert(upper && upper->minHash == split && upper->maxHash == HASH_MAX);
+    assert(table->minHash == 0 && table->maxHash == split - 1);
+    check_entries(table, versions);
+    check_entries(upper, versions);
+    assert(count_entries(upper) == count_in_range(split, HASH_MAX, versions));
+    assert(count_entries(table) + count_entries(upper) == total);
+
+    split = HASH_MAX / 4 + 1;
+    hash_table *lower = hash_table_detach_range(table, 0, split - 1);
+
+    assert(lower && lower->minHash == 0 && lower->maxHash == split - 1);
+    assert(table->minHash == split);
+    check_entries(table, versions);
+    check_entries(lower, versions);
+    assert(count_entries(lower) + count_entries(table) + count_entries(upper) == total);
+
+    hash_table_destroy(lower);
+    hash_table_destroy(upper);
+    hash_table_destroy(table);
+}
+
+/**
+ * Removes entries and inserts some of them again, every removal leaves a tombstone until its slot is
+ * taken by a new entry or the bucket is rehashed
+ */
+static void test_tombstones(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(0, HASH_MAX, versions);
+    char ssn[SSN_LENGTH + 1];
+    char name[32];
+    char email[32];
+    long removed = 0;
+
+    assert(count_tombstones(table) == 0);
+
+    for(int i = 0; i < TEST_ENTRIES; i += 2) {
+        make_ssn(i, ssn);
+        versions[i] = 0;
+        assert(hash_table_remove(table, ssn) == 0);
+        removed += 1;
+    }
+
+    assert(count_tombstones(table) == removed);
+    check_entries(table, versions);
+
+    //Removing a missing ssn changes nothing
+    make_ssn(0, ssn);
+    hash_table_remove(table, ssn);
+    assert(count_tombstones(table) == removed);
+
+    for(int i = 0; i < TEST_ENTRIES; i += 4) {
+        make_ssn(i, ssn);
+        versions[i] = 2;
+        assert(hash_table_insert(table, ssn, name, make_name(i, 2, name), email, make_email(i, email)) == 0);
+    }
+
+    assert(count_tombstones(table) <= removed);
+    check_entries(table, versions);
+    assert(count_entries(table) == count_in_range(0, HASH_MAX, versions));
+
+    hash_table_destroy(table);
+}
+
+/**
+ * Compacts a table a bucket at a time after most of it is removed, then removes the rest and compacts
+ * until every bucket has given back its memory
+ */
+static void test_compact(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(0, HASH_MAX, versions);
+    char ssn[SSN_LENGTH + 1];
+    long capacity = count_capacity(table);
+
+    for(int i = 0; i < TEST_ENTRIES; i++) {
+        if(i % 8 != 0) {
+            make_ssn(i, ssn);
+            versions[i] = 0;
+            assert(hash_table_remove(table, ssn) == 0);
+        }
+    }
+
+    assert(count_capacity(table) == capacity);
+    assert(hash_table_compact(table, 1) == 1);
+
+    while(hash_table_compact(table, 1) > 0);
+
+    assert(count_capacity(table) < capacity);
+    assert(count_tombstones(table) < count_entries(table));
+    check_entries(table, versions);
+    assert(count_entries(table) == count_in_range(0, HASH_MAX, versions));
+
+    for(int i = 0; i < TEST_ENTRIES; i += 8) {
+        make_ssn(i, ssn);
+        versions[i] = 0;
+        assert(hash_table_remove(table, ssn) == 0);
+    }
+
+    while(hash_table_compact(table, TEST_ENTRIES) > 0);
+
+    assert(count_entries(table) == 0 && count_tombstones(table) == 0 && count_capacity(table) == 0);
+    check_entries(table, versions);
+
+    hash_table_destroy(table);
+}
+
+/**
+ * Looks up every generated ssn with and without counting, only the counted lookups of missing ssns
+ * show up in the filter stats
+ */
+static void test_filter_stats(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(0, HASH_MAX, versions);
+    hash_table_filter_stats stats;
+    hash_table_entry entry;
+    char ssn[SSN_LENGTH + 1];
+    long missing = 0;
+
+    for(int i = 0; i < TEST_ENTRIES; i += 2) {
+        make_ssn(i, ssn);
+        versions[i] = 0;
+        assert(hash_table_remove(table, ssn) == 0);
+        missing += 1;
+    }
+
+    for(int i = 0; i < TEST_ENTRIES; i++) {
+        make_ssn(i, ssn);
+        assert(hash_table_contains(table, ssn, &entry) == (versions[i] != 0));
+    }
+
+    hash_table_get_filter_stats(table, &stats);
+    assert(stats.rejects == 0 && stats.falsePositives == 0);
+
+    check_entries(table, versions);
+    hash_table_get_filter_stats(table, &stats);
+    assert((long)(stats.rejects + stats.falsePositives) == missing);
+
+    hash_table_destroy(table);
+}
+
+/**
+ * Saves a table and maps it back, then changes the mapped table and saves and maps that one as well
+ */
+static void test_save_open(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(HASH_MAX / 4, HASH_MAX, versions);
+    char ssn[SSN_LENGTH + 1];
+    char name[32];
+    char email[32];
+
+    for(int i = 0; i < TEST_ENTRIES; i += 5) {
+        make_ssn(i, ssn);
+
+        if(versions[i]) {
+            versions[i] = 0;
+            assert(hash_table_remove(table, ssn) == 0);
+        }
+    }
+
+    assert(hash_table_open(TEST_FILE) == NULL);
+    assert(hash_table_save(table, TEST_FILE) == 0);
+    hash_table_destroy(table);
+
+    table = hash_table_open(TEST_FILE);
+    assert(table && table->minHash == HASH_MAX / 4 && table->maxHash == HASH_MAX);
+    check_entries(table, versions);
+    assert(count_entries(table) == count_in_range(HASH_MAX / 4, HASH_MAX, versions));
+
+    //Records in the mapping are replaced, removed and compacted away like any other
+    for(int i = 0; i < TEST_ENTRIES; i += 2) {
+        make_ssn(i, ssn);
 
+        if(hash_table_insert(table, ssn, name, make_name(i, 3, name), email, make_email(i, email)) == 0) {
+            versions[i] = 3;
+        }
+    }
 
-    hash_table *table = hash_table_create(0,255);
+    for(int i = 1; i < TEST_ENTRIES; i += 6) {
+        make_ssn(i, ssn);
 
-    hash_table_entry *entry = hash_table_create_entry("aaaaabbbbbcc", "Rolf", "rolf@gmail.com");
-    if(hash_table_insert(table, entry) == -1 ){
-        fprintf(stderr, "inserting element");
-        exit(EXIT_FAILURE);
+        if(versions[i]) {
+            versions[i] = 0;
+            assert(hash_table_remove(table, ssn) == 0);
+        }
     }
 
-    hash_table_entry *entry2 = hash_table_create_entry("aaabbbbbcccc", "Adam", "adam@gmail.com");
-    hash_table_insert(table, entry2);
+    while(hash_table_compact(table, TEST_ENTRIES) > 0);
+    check_entries(table, versions);
 
+    assert(hash_table_save(table, TEST_COPY) == 0);
+    hash_table *copy = hash_table_open(TEST_COPY);
 
-    hash_table_entry *entry3 = hash_table_create_entry("aaaaaccccccc", "Jerry", "jerry@gmail.com");
-    hash_table_insert(table, entry3);
+    assert(copy);
+    check_entries(copy, versions);
+    assert(count_entries(copy) == count_entries(table));
 
-    hash_table_remove(table, "aaaaabbbbbcc");
-    table = hash_table_resize(table, 10, 200);
-    hash_table_remove(table, "aaaaaccccccc");
-    table = hash_table_resize(table, 0, 30);
-    hash_table_remove(table, "aaabbbbbcccc");
-    table = hash_table_resize(table, 90, 100);
-    hash_table_print(table);
-    //table = hash_table_resize(table, 20, 30);
+    hash_table_destroy(copy);
+    hash_table_destroy(table);
+    unlink(TEST_FILE);
+    unlink(TEST_COPY);
+}
 
+/**
+ * Cuts a saved table short at every few bytes, with the size in its header patched to match so only
+ * the offsets inside the file can give it away. None of them may be opened
+ */
+static void test_open_corrupt(void) {
+    int versions[TEST_ENTRIES] = {0};
+    hash_table *table = fill(0, HASH_MAX, versions);
+    uint8_t *bytes;
+
+    assert(hash_table_save(table, TEST_FILE) == 0);
     hash_table_destroy(table);
+
+    long size = read_file(TEST_FILE, &bytes);
+    long sizeField = -1;
+
+    for(long i = 0; i + 8 <= 64 && sizeField < 0; i += 8) {
+        uint64_t value;
+        memcpy(&value, bytes + i, sizeof(value));
+        sizeField = value == (uint64_t)size ? i : -1;
+    }
+
+    assert(sizeField >= 0);
+
+    for(long cut = sizeField + 8; cut < size; cut += 61) {
+        uint64_t value = cut;
+
+        memcpy(bytes + sizeField, &value, sizeof(value));
+        write_file(TEST_COPY, bytes, cut);
+        assert(hash_table_open(TEST_COPY) == NULL);
+    }
+
+    free(bytes);
+    unlink(TEST_FILE);
+    unlink(TEST_COPY);
+}
+
+/**
+ * Creates a table and inserts every generated ssn into it, the ones outside the range are refused
+ *
+ * @param min
+ * @param max
+ * @param versions set to 1 for every ssn in the table
+ * @return the table
+ */
+static hash_table *fill(hash_t min, hash_t max, int *versions) {
+    hash_table *table = hash_table_create(min, max);
+    char ssn[SSN_LENGTH + 1];
+    char name[32];
+    char email[32];
+
+    for(int i = 0; i < TEST_ENTRIES; i++) {
+        make_ssn(i, ssn);
+
+        int inRange = hash_ssn(ssn) >= min && hash_ssn(ssn) <= max;
+        int status = hash_table_insert(table, ssn, name, make_name(i, 1, name), email, make_email(i, email));
+
+        assert(status == (inRange ? 0 : -1));
+        versions[i] = inRange;
+    }
+
+    return table;
+}
+
+/**
+ * Looks up every generated ssn, one in the range of the table has to be there with the name of its
+ * version or be missing if the version is 0
+ *
+ * @param table
+ * @param versions
+ */
+static void check_entries(hash_table *table, const int *versions) {
+    char ssn[SSN_LENGTH + 1];
+    char name[32];
+    char email[32];
+    hash_table_entry entry;
+
+    for(int i = 0; i < TEST_ENTRIES; i++) {
+        make_ssn(i, ssn);
+
+        int status = hash_table_lookup(table, ssn, &entry);
+
+        if(hash_ssn(ssn) < table->minHash || hash_ssn(ssn) > table->maxHash) {
+            assert(status == -1);
+            continue;
+        }
+
+        assert(status == 0);
+
+        if(versions[i] == 0) {
+            assert(entry.name == NULL);
+            continue;
+        }
+
+        int nameLength = make_name(i, versions[i], name);
+        int emailLength = make_email(i, email);
+
+        assert(entry.name != NULL);
+        assert(memcmp(entry.ssn, ssn, SSN_LENGTH) == 0);
+        assert(entry.nameLength == nameLength && memcmp(entry.name, name, nameLength) == 0);
+        assert(entry.emailLength == emailLength && memcmp(entry.email, email, emailLength) == 0);
+    }
+}
+
+/**
+ * Counts the entries of a table by walking its buckets
+ *
+ * @param table
+ * @return the number of entries
+ */
+static long count_entries(hash_table *table) {
+    hash_table_entry entry;
+    long count = 0;
+
+    for(int i = 0; i < hash_table_get_bucket_count(table); i++) {
+        bucket *b = hash_table_get_buckets_from(table, i);
+
+        for(int j = hash_table_bucket_next(b, 0, &entry); j >= 0; j = hash_table_bucket_next(b, j + 1, &entry)) {
+            count += 1;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Counts the tombstones of a table
+ *
+ * @param table
+ * @return the number of tombstones
+ */
+static long count_tombstones(hash_table *table) {
+    long count = 0;
+
+    for(int i = 0; i < hash_table_get_bucket_count(table); i++) {
+        count += hash_table_get_buckets_from(table, i)->tombstones;
+    }
+
+    return count;
+}
+
+/**
+ * Counts the slots of a table
+ *
+ * @param table
+ * @return the number of slots
+ */
+static long count_capacity(hash_table *table) {
+    long count = 0;
+
+    for(int i = 0; i < hash_table_get_bucket_count(table); i++) {
+        count += hash_table_get_buckets_from(table, i)->capacity;
+    }
+
+    return count;
+}
+
+/**
+ * Counts the generated ssns that should be in a table with a range
+ *
+ * @param min
+ * @param max
+ * @param versions
+ * @return the number of ssns
+ */
+static long count_in_range(hash_t min, hash_t max, const int *versions) {
+    char ssn[SSN_LENGTH + 1];
+    long count = 0;
+
+    for(int i = 0; i < TEST_ENTRIES; i++) {
+        make_ssn(i, ssn);
+
+        if(versions[i] != 0 && hash_ssn(ssn) >= min && hash_ssn(ssn) <= max) {
+            count += 1;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Generates ssn number i, every seventh one has letters in it so it is stored as a raw key
+ *
+ * @param i
+ * @param ssn at least SSN_LENGTH + 1 bytes
+ */
+static void make_ssn(int i, char *ssn) {
+    snprintf(ssn, SSN_LENGTH + 1, "%012lld", 190001010000LL + (long long)i * 7919);
+
+    if(i % 7 == 0) {
+        ssn[4] = (char)('a' + i % 26);
+    }
+}
+
+/**
+ * Generates the name of ssn number i
+ *
+ * @param i
+ * @param version
+ * @param name at least 32 bytes
+ * @return the length of the name
+ */
+static int make_name(int i, int version, char *name) {
+    return snprintf(name, 32, "Name %d.%d", i, version);
+}
+
+/**
+ * Generates the email of ssn number i
+ *
+ * @param i
+ * @param email at least 32 bytes
+ * @return the length of the email
+ */
+static int make_email(int i, char *email) {
+    return snprintf(email, 32, "n%d@example.se", i);
+}
+
+/**
+ * Reads a whole file into memory
+ *
+ * @param path
+ * @param bytes set to the contents, freed by the caller
+ * @return the size of the file
+ */
+static long read_file(const char *path, uint8_t **bytes) {
+    FILE *file = fopen(path, "rb");
+
+    assert(file);
+    fseek(file, 0, SEEK_END);
+
+    long size = ftell(file);
+
+    rewind(file);
+    *bytes = malloc(size);
+    assert(*bytes && fread(*bytes, 1, size, file) == (size_t)size);
+    fclose(file);
+
+    return size;
+}
+
+/**
+ * Writes bytes to a file, replacing it
+ *
+ * @param path
+ * @param bytes
+ * @param size
+ */
+static void write_file(const char *path, const uint8_t *bytes, long size) {
+    FILE *file = fopen(path, "wb");
+
+    assert(file && fwrite(bytes, 1, size, file) == (size_t)size);
+    fclose(file);
 }
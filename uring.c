@@ -0,0 +1,697 @@
+/**
+ * uring.c
+ *
+ * This file represents the io_uring backend of the socket layer. Every socket of the node has one multishot
+ * recv that fills buffers from a provided buffer ring, the data is copied into the socket buffers as they
+ * have room. Sends are queued with a copy of the PDU and submitted together with the next wait, sends on
+ * the same stream socket are linked so they keep their order. Only the kernel header is used, the rings
+ * are set up with the raw syscalls.
+ *
+ */
+
+#include "uring.h"
+
+#if IO_URING
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define URING_SEND_DATA (1ULL << 62)
+#define URING_CANCEL_DATA (1ULL << 61)
+#define URING_STREAM_DATA 1ULL
+#define URING_BUFFER_GROUP 0
+
+/**
+ * Received bytes waiting in a provided buffer until the socket buffer has room for them
+ */
+typedef struct {
+    uint16_t bid;
+    int offset;
+    int len;
+} uring_chunk;
+
+/**
+ * A socket with its multishot recv. The generation is part of the user data of the recv so completions
+ * of a recv that was cancelled are told apart from the current one
+ */
+typedef struct {
+    int fd;
+    int datagram;
+    int armed;
+    int closed;
+    uint32_t generation;
+    socket_buffer *buffer;
+    uring_chunk pending[URING_BUFFERS];
+    int head;
+    int count;
+} uring_source;
+
+/**
+ * A queued send, the bytes are in the arena of the ring
+ */
+typedef struct {
+    int fd;
+    int datagram;
+    struct sockaddr_in addr;
+    struct iovec iov;
+    struct msghdr message;
+} uring_send_slot;
+
+struct uring {
+    int fd;
+    int tick;
+    void *sqRing;
+    void *cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqLocalTail;
+    unsigned sqEntries;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_buf_ring *bufferRing;
+    char *buffers;
+    uint16_t bufferTail;
+    int buffersHeld;
+    uring_source sources[URING_MAX_SOURCES];
+    uring_send_slot sends[URING_SEND_QUEUE];
+    int used;
+    int submitted;
+    int outstanding;
+    int streamOutstanding;
+    char *arena;
+    size_t arenaUsed;
+};
+
+static int uring_enter(uring *u, unsigned wait, int timeout);
+static struct io_uring_sqe *uring_get_sqe(uring *u);
+static void uring_arm(uring *u, int probe);
+static void uring_submit_sends(uring *u);
+static int uring_reap(uring *u);
+static void uring_complete(uring *u, struct io_uring_cqe *cqe);
+static int uring_deliver(uring_source *s, uring *u);
+static void uring_recycle(uring *u, uint16_t bid);
+static void uring_drop(uring *u, uring_source *s);
+
+/**
+ * Sets up the ring and registers the provided buffers
+ *
+ * @param tick the longest a wait blocks in milliseconds, so periodic work runs without traffic
+ * @return the ring
+ */
+uring *uring_create(int tick) {
+    uring *u = calloc(1, sizeof(*u));
+    struct io_uring_params params = {};
+
+    if(!u) {
+        perror("uring || calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    u->tick = tick;
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    u->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+
+    if(u->fd < 0) {
+        perror("io_uring_setup");
+        exit(EXIT_FAILURE);
+    }
+
+    u->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    u->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        u->sqRingSize = u->cqRingSize > u->sqRingSize ? u->cqRingSize : u->sqRingSize;
+        u->cqRingSize = u->sqRingSize;
+    }
+
+    u->sqRing = mmap(NULL, u->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    u->cqRing = params.features & IORING_FEAT_SINGLE_MMAP ? u->sqRing
+            : mmap(NULL, u->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    u->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+
+    if(u->sqRing == MAP_FAILED || u->cqRing == MAP_FAILED || u->sqes == MAP_FAILED) {
+        perror("mmap || io_uring");
+        exit(EXIT_FAILURE);
+    }
+
+    u->sqHead = (unsigned*)((char*)u->sqRing + params.sq_off.head);
+    u->sqTail = (unsigned*)((char*)u->sqRing + params.sq_off.tail);
+    u->sqMask = (unsigned*)((char*)u->sqRing + params.sq_off.ring_mask);
+    u->sqArray = (unsigned*)((char*)u->sqRing + params.sq_off.array);
+    u->sqEntries = params.sq_entries;
+    u->sqLocalTail = *u->sqTail;
+    u->cqHead = (unsigned*)((char*)u->cqRing + params.cq_off.head);
+    u->cqTail = (unsigned*)((char*)u->cqRing + params.cq_off.tail);
+    u->cqMask = (unsigned*)((char*)u->cqRing + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)((char*)u->cqRing + params.cq_off.cqes);
+
+    //The kernel wants the buffer ring page aligned
+    u->bufferRing = mmap(NULL, URING_BUFFERS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->buffers = malloc((size_t)URING_BUFFERS * URING_BUFFER_SIZE);
+    u->arena = malloc(URING_SEND_ARENA);
+
+    if(u->bufferRing == MAP_FAILED || !u->buffers || !u->arena) {
+        perror("uring || buffers");
+        exit(EXIT_FAILURE);
+    }
+
+    struct io_uring_buf_reg reg = {};
+    reg.ring_addr = (uint64_t)(uintptr_t)u->bufferRing;
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+
+    if(syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("io_uring_register || IORING_REGISTER_PBUF_RING");
+        exit(EXIT_FAILURE);
+    }
+
+    for(int i = 0; i < URING_BUFFERS; i++) {
+        uring_recycle(u, (uint16_t)i);
+    }
+    __atomic_store_n(&u->bufferRing->tail, u->bufferTail, __ATOMIC_RELEASE);
+
+    for(int i = 0; i < URING_MAX_SOURCES; i++) {
+        u->sources[i].fd = -1;
+    }
+
+    return u;
+}
+
+/**
+ * Makes fd the socket of a source, the received bytes go to buffer. Nothing changes when the source already
+ * has fd. A socket that is closed has to be passed to uring_forget first, the recv holds on to it otherwise
+ *
+ * @param u
+ * @param source between 0 and URING_MAX_SOURCES
+ * @param fd -1 leaves the source without a socket
+ * @param datagram 1 for a UDP socket, whose datagrams are only copied whole
+ * @param buffer
+ */
+void uring_watch(uring *u, int source, int fd, int datagram, socket_buffer *buffer) {
+    uring_source *s = &u->sources[source];
+
+    s->buffer = buffer;
+
+    if(s->fd == fd) {
+        return;
+    }
+
+    if(s->fd != -1) {
+        uring_drop(u, s);
+    }
+
+    s->fd = fd;
+    s->datagram = datagram;
+}
+
+/**
+ * Cancels the recv on a socket that is about to be closed, bytes it has not handed over are dropped
+ * like the ones left in a closed socket
+ *
+ * @param u
+ * @param fd
+ */
+void uring_forget(uring *u, int fd) {
+    uring_flush(u);
+
+    for(int i = 0; i < URING_MAX_SOURCES; i++) {
+        if(u->sources[i].fd == fd) {
+            uring_drop(u, &u->sources[i]);
+        }
+    }
+
+    uring_enter(u, 0, 0);
+}
+
+/**
+ * Queues a PDU, the bytes are copied so the caller can reuse them at once. The queue is submitted by the
+ * next uring_wait that blocks or once it holds URING_SEND_BATCH PDUs
+ *
+ * @param u
+ * @param fd
+ * @param iov the PDU
+ * @param count the number of iovecs
+ * @param addr the receiver of a datagram, NULL for a stream socket
+ */
+void uring_send(uring *u, int fd, const struct iovec *iov, int count, const struct sockaddr_in *addr) {
+    size_t len = 0;
+
+    for(int i = 0; i < count; i++) {
+        len += iov[i].iov_len;
+    }
+
+    if(u->used == URING_SEND_QUEUE || u->arenaUsed + len > URING_SEND_ARENA) {
+        uring_flush(u);
+    }
+
+    if(len > URING_SEND_ARENA) {
+        fprintf(stderr, "uring_send: %zu bytes is more than the arena holds\n", len);
+        exit(EXIT_FAILURE);
+    }
+
+    uring_send_slot *slot = &u->sends[u->used++];
+    char *bytes = u->arena + u->arenaUsed;
+
+    for(int i = 0, offset = 0; i < count; offset += (int)iov[i].iov_len, i++) {
+        memcpy(bytes + offset, iov[i].iov_base, iov[i].iov_len);
+    }
+
+    u->arenaUsed += len;
+
+    slot->fd = fd;
+    slot->datagram = addr != NULL;
+    slot->iov = (struct iovec){bytes, len};
+
+    if(addr) {
+        slot->addr = *addr;
+        slot->message = (struct msghdr){};
+        slot->message.msg_name = &slot->addr;
+        slot->message.msg_namelen = sizeof(slot->addr);
+        slot->message.msg_iov = &slot->iov;
+        slot->message.msg_iovlen = 1;
+    }
+}
+
+/**
+ * Submits the queued sends and waits until every send is done, before other code writes to the sockets
+ *
+ * @param u
+ */
+void uring_flush(uring *u) {
+    uring_submit_sends(u);
+    uring_enter(u, 0, 0);
+
+    while(u->outstanding > 0) {
+        if(uring_reap(u) == 0) {
+            uring_enter(u, 1, -1);
+        }
+    }
+
+    for(int i = 0; i < URING_MAX_SOURCES; i++) {
+        uring_deliver(&u->sources[i], u);
+    }
+}
+
+/**
+ * Moves received bytes into the socket buffers, waiting for them if none have arrived. A wait that does
+ * not block only takes what the kernel has already posted and leaves the sends queued until there are
+ * URING_SEND_BATCH of them, so a node busy with a stream of PDUs enters the kernel once per batch. Once
+ * the buffers run dry the caller blocks, which sends the rest
+ *
+ * @param u
+ * @param timeout in milliseconds, 0 does not block and -1 blocks for at most the tick of the ring
+ */
+void uring_wait(uring *u, int timeout) {
+    uring_arm(u, timeout != 0);
+
+    int received = uring_reap(u);
+
+    //Bytes held back while a socket buffer was full fit now that it has been read, which is work as well
+    for(int i = 0; i < URING_MAX_SOURCES; i++) {
+        received += uring_deliver(&u->sources[i], u);
+    }
+
+    if(timeout != 0 || u->used - u->submitted >= URING_SEND_BATCH || *u->sqTail != u->sqLocalTail) {
+        uring_submit_sends(u);
+        uring_enter(u, received || timeout == 0 ? 0 : 1, timeout == -1 ? u->tick : timeout);
+        uring_reap(u);
+    }
+
+    for(int i = 0; i < URING_MAX_SOURCES; i++) {
+        uring_deliver(&u->sources[i], u);
+    }
+}
+
+/**
+ * Closes the ring, which cancels everything in it
+ *
+ * @param u
+ */
+void uring_destroy(uring *u) {
+    uring_flush(u);
+    close(u->fd);
+    munmap(u->sqes, u->sqEntries * sizeof(struct io_uring_sqe));
+    if(u->cqRing != u->sqRing) {
+        munmap(u->cqRing, u->cqRingSize);
+    }
+    munmap(u->sqRing, u->sqRingSize);
+    munmap(u->bufferRing, URING_BUFFERS * sizeof(struct io_uring_buf));
+    free(u->buffers);
+    free(u->arena);
+    free(u);
+}
+
+/**
+ * Publishes the new submissions and enters the kernel if there is something to submit or wait for
+ *
+ * @param u
+ * @param wait the number of completions to wait for
+ * @param timeout in milliseconds when waiting, -1 waits without one
+ * @return the number of submissions the kernel took
+ */
+static int uring_enter(uring *u, unsigned wait, int timeout) {
+    unsigned submit = u->sqLocalTail - *u->sqTail;
+
+    __atomic_store_n(u->sqTail, u->sqLocalTail, __ATOMIC_RELEASE);
+
+    if(submit == 0 && wait == 0) {
+        return 0;
+    }
+
+    struct __kernel_timespec ts = {timeout / 1000, (timeout % 1000) * 1000000L};
+    struct io_uring_getevents_arg arg = {};
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+
+    unsigned flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    if(wait > 0 && timeout >= 0) {
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+
+    int result;
+
+    if(flags & IORING_ENTER_EXT_ARG) {
+        result = (int)syscall(__NR_io_uring_enter, u->fd, submit, wait, flags, &arg, sizeof(arg));
+    } else {
+        result = (int)syscall(__NR_io_uring_enter, u->fd, submit, wait, flags, NULL, 0);
+    }
+
+    if(result < 0 && errno != EINTR && errno != ETIME && errno != EAGAIN && errno != EBUSY) {
+        perror("io_uring_enter");
+        exit(EXIT_FAILURE);
+    }
+
+    return result < 0 ? 0 : result;
+}
+
+/**
+ * Takes the next free submission entry, entering the kernel first if the queue is full
+ *
+ * @param u
+ * @return the entry, zeroed
+ */
+static struct io_uring_sqe *uring_get_sqe(uring *u) {
+    while(u->sqLocalTail - __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE) >= u->sqEntries) {
+        uring_enter(u, 0, 0);
+    }
+
+    unsigned index = u->sqLocalTail & *u->sqMask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    u->sqArray[index] = index;
+    u->sqLocalTail++;
+
+    return sqe;
+}
+
+/**
+ * Starts a multishot recv on every source that lacks one. A stream socket gets one once it is connected,
+ * and a stream that reached its end gets no new one until the source has another socket
+ *
+ * @param u
+ * @param probe 1 to look again at stream sockets that were not connected, which costs a syscall each
+ */
+static void uring_arm(uring *u, int probe) {
+    for(int i = 0; i < URING_MAX_SOURCES; i++) {
+        uring_source *s = &u->sources[i];
+
+        if(s->fd == -1 || s->armed || s->closed || u->buffersHeld == URING_BUFFERS) {
+            continue;
+        }
+
+        if(!s->datagram) {
+            if(!probe) {
+                continue;
+            }
+
+            struct sockaddr_in peer;
+            socklen_t length = sizeof(peer);
+
+            if(getpeername(s->fd, (struct sockaddr*)&peer, &length) == -1) {
+                continue;
+            }
+        }
+
+        struct io_uring_sqe *sqe = uring_get_sqe(u);
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = s->fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = URING_BUFFER_GROUP;
+        sqe->user_data = ((uint64_t)s->generation << 8) | (uint64_t)i;
+
+        s->armed = 1;
+    }
+}
+
+/**
+ * Turns the queued sends into submission entries. The sends of a stream socket are linked in the order
+ * they were queued, datagrams go out independently. Links do not reach back to an earlier submission, so
+ * stream sends still in flight from one are waited for first
+ *
+ * @param u
+ */
+static void uring_submit_sends(uring *u) {
+    int streams = 0;
+
+    for(int i = u->submitted; i < u->used; i++) {
+        streams += !u->sends[i].datagram;
+    }
+
+    while(streams > 0 && u->streamOutstanding > 0) {
+        if(uring_reap(u) == 0 && u->streamOutstanding > 0) {
+            uring_enter(u, 1, -1);
+        }
+    }
+
+    for(int i = u->submitted; i < u->used; i++) {
+        uring_send_slot *slot = &u->sends[i];
+
+        if(slot->fd == -1) {
+            continue;
+        }
+
+        if(slot->datagram) {
+            struct io_uring_sqe *sqe = uring_get_sqe(u);
+
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = slot->fd;
+            sqe->addr = (uint64_t)(uintptr_t)&slot->message;
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = URING_SEND_DATA;
+            u->outstanding++;
+            continue;
+        }
+
+        int fd = slot->fd;
+        struct io_uring_sqe *last = NULL;
+
+        for(int j = i; j < u->used; j++) {
+            if(u->sends[j].fd != fd || u->sends[j].datagram) {
+                continue;
+            }
+
+            if(last) {
+                last->flags |= IOSQE_IO_LINK;
+            }
+
+            last = uring_get_sqe(u);
+            last->opcode = IORING_OP_SEND;
+            last->fd = fd;
+            last->addr = (uint64_t)(uintptr_t)u->sends[j].iov.iov_base;
+            last->len = (unsigned)u->sends[j].iov.iov_len;
+            last->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+            last->user_data = URING_SEND_DATA | URING_STREAM_DATA;
+            u->outstanding++;
+            u->streamOutstanding++;
+
+            //Taken by the chain, the outer loop skips it
+            if(j != i) {
+                u->sends[j].fd = -1;
+            }
+        }
+    }
+
+    u->submitted = u->used;
+}
+
+/**
+ * Handles the completions the kernel has posted, without entering it
+ *
+ * @param u
+ * @return the number of completions that brought received bytes
+ */
+static int uring_reap(uring *u) {
+    unsigned head = *u->cqHead;
+    unsigned tail = __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE);
+    int received = 0;
+
+    for(; head != tail; head++) {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cqMask];
+
+        received += !(cqe->user_data & (URING_SEND_DATA | URING_CANCEL_DATA)) && cqe->res > 0;
+        uring_complete(u, cqe);
+    }
+
+    __atomic_store_n(u->cqHead, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&u->bufferRing->tail, u->bufferTail, __ATOMIC_RELEASE);
+
+    if(u->outstanding == 0 && u->submitted == u->used) {
+        u->used = 0;
+        u->submitted = 0;
+        u->arenaUsed = 0;
+    }
+
+    return received;
+}
+
+/**
+ * Handles one completion
+ *
+ * @param u
+ * @param cqe
+ */
+static void uring_complete(uring *u, struct io_uring_cqe *cqe) {
+    if(cqe->user_data & URING_SEND_DATA) {
+        //Send errors were not looked at before either, a broken successor shows up when it is read from
+        u->outstanding--;
+        u->streamOutstanding -= (cqe->user_data & URING_STREAM_DATA) != 0;
+        return;
+    }
+
+    if(cqe->user_data & URING_CANCEL_DATA) {
+        return;
+    }
+
+    uring_source *s = &u->sources[cqe->user_data & 0xff];
+    int hasBuffer = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+    if(s->fd == -1 || (uint32_t)(cqe->user_data >> 8) != s->generation) {
+        if(hasBuffer) {
+            uring_recycle(u, bid);
+        }
+        return;
+    }
+
+    if(hasBuffer && cqe->res > 0) {
+        s->pending[(s->head + s->count) % URING_BUFFERS] = (uring_chunk){bid, 0, cqe->res};
+        s->count++;
+        u->buffersHeld++;
+    } else if(hasBuffer) {
+        uring_recycle(u, bid);
+    }
+
+    if(!(cqe->flags & IORING_CQE_F_MORE)) {
+        s->armed = 0;
+        //Out of buffers is rearmed once some are back, the end of a stream is final for this socket
+        s->closed = cqe->res != -ENOBUFS && !s->datagram;
+    }
+}
+
+/**
+ * Copies what the socket buffer has room for out of the provided buffers and gives those back
+ *
+ * @param s
+ * @param u
+ * @return the number of bytes copied
+ */
+static int uring_deliver(uring_source *s, uring *u) {
+    int copied = 0;
+
+    while(s->fd != -1 && s->count > 0) {
+        uring_chunk *chunk = &s->pending[s->head];
+        int room = s->buffer->capacity - s->buffer->len;
+        int n = chunk->len - chunk->offset;
+
+        if(s->datagram ? n > room : room == 0) {
+            break;
+        }
+
+        n = n < room ? n : room;
+        memcpy(s->buffer->buffer + s->buffer->len, u->buffers + (size_t)chunk->bid * URING_BUFFER_SIZE + chunk->offset, n);
+        s->buffer->len += n;
+        chunk->offset += n;
+        copied += n;
+
+        if(chunk->offset == chunk->len) {
+            uring_recycle(u, chunk->bid);
+            u->buffersHeld--;
+            s->head = (s->head + 1) % URING_BUFFERS;
+            s->count--;
+        }
+    }
+
+    __atomic_store_n(&u->bufferRing->tail, u->bufferTail, __ATOMIC_RELEASE);
+
+    return copied;
+}
+
+/**
+ * Gives a buffer back to the kernel, the tail is published by the caller
+ *
+ * @param u
+ * @param bid
+ */
+static void uring_recycle(uring *u, uint16_t bid) {
+    struct io_uring_buf *buf = &u->bufferRing->bufs[u->bufferTail & (URING_BUFFERS - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)(u->buffers + (size_t)bid * URING_BUFFER_SIZE);
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = bid;
+    u->bufferTail++;
+}
+
+/**
+ * Cancels the recv of a source and gives back the buffers it holds, the source is left without a socket
+ *
+ * @param u
+ * @param s
+ */
+static void uring_drop(uring *u, uring_source *s) {
+    if(s->armed) {
+        struct io_uring_sqe *sqe = uring_get_sqe(u);
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = ((uint64_t)s->generation << 8) | (uint64_t)(s - u->sources);
+        sqe->user_data = URING_CANCEL_DATA;
+    }
+
+    for(; s->count > 0; s->count--) {
+        uring_recycle(u, s->pending[s->head].bid);
+        u->buffersHeld--;
+        s->head = (s->head + 1) % URING_BUFFERS;
+    }
+
+    __atomic_store_n(&u->bufferRing->tail, u->bufferTail, __ATOMIC_RELEASE);
+
+    s->fd = -1;
+    s->armed = 0;
+    s->closed = 0;
+    s->head = 0;
+    s->generation++;
+}
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * uring.h
+ *
+ * This file represents the interface for the io_uring backend of the socket layer of a node
+ *
+ */
+
+#ifndef OU3_URING_H
+#define OU3_URING_H
+
+#include <netinet/in.h>
+#include <sys/uio.h>
+#include "socket_buffer.h"
+
+//With IO_URING set the main loop receives with multishot recvs into a provided buffer ring and sends the
+//PDUs of the value path in batches, instead of the epoll reactor and one syscall per read and send
+#ifndef IO_URING
+#define IO_URING 0
+#endif
+
+#define URING_ENTRIES 256
+#define URING_MAX_SOURCES 8
+#define URING_BUFFERS 64
+#define URING_BUFFER_SIZE 16384
+#define URING_SEND_QUEUE 64
+#define URING_SEND_ARENA 262144
+#define URING_SEND_BATCH 16
+
+/**
+ * The ring, its sockets and the queued sends, see uring.c
+ */
+typedef struct uring uring;
+
+uring *uring_create(int tick);
+void uring_watch(uring *u, int source, int fd, int datagram, socket_buffer *buffer);
+void uring_forget(uring *u, int fd);
+void uring_send(uring *u, int fd, const struct iovec *iov, int count, const struct sockaddr_in *addr);
+void uring_flush(uring *u);
+void uring_wait(uring *u, int timeout);
+void uring_destroy(uring *u);
+
+#endif //OU3_URING_H
@@ -0,0 +1,371 @@
+/**
+ * wal.c
+ *
+ * This file represents the implementation of the write-ahead log. Every record is a VAL_INSERT or VAL_REMOVE
+ * PDU, the log is replayed on top of the last saved table when a node starts and truncated every time the
+ * table is saved.
+ *
+ */
+
+#include "wal.h"
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * The work of one replay thread, it applies the records of every bucket congruent to id modulo threads
+ */
+typedef struct {
+    const uint8_t *log;
+    const long *offsets;
+    const long *starts;
+    hash_table *table;
+    int id;
+    int threads;
+} wal_replay_job;
+
+static void wal_reserve(wal *w, size_t len);
+static long wal_record_length(const uint8_t *log, long offset, long size);
+static void *wal_replay_buckets(void *arg);
+
+/**
+ * Opens a write-ahead log for appending, the file is created if it is missing
+ *
+ * @param path
+ * @return the log or NULL if the file could not be opened
+ */
+wal *wal_open(const char *path) {
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+
+    if(fd < 0) {
+        perror("wal_open || open");
+        return NULL;
+    }
+
+    wal *w = calloc(1, sizeof(*w));
+    w->fd = fd;
+
+    return w;
+}
+
+/**
+ * Commits the buffered records and closes the log
+ *
+ * @param w
+ */
+void wal_close(wal *w) {
+    wal_commit(w);
+    close(w->fd);
+    free(w->buffer);
+    free(w);
+}
+
+/**
+ * Buffers an insert record
+ *
+ * @param w
+ * @param ssn
+ * @param name
+ * @param nameLength
+ * @param email
+ * @param emailLength
+ */
+void wal_append_insert(wal *w, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength) {
+    wal_reserve(w, VAL_INSERT_BASE_LENGTH + nameLength + emailLength);
+
+    char *bytes = w->buffer + w->len;
+    bytes[0] = VAL_INSERT;
+    memcpy(bytes + 1, ssn, SSN_LENGTH);
+    bytes[1 + SSN_LENGTH] = nameLength;
+    memcpy(bytes + 2 + SSN_LENGTH, name, nameLength);
+    bytes[2 + SSN_LENGTH + nameLength] = emailLength;
+    memcpy(bytes + 3 + SSN_LENGTH + nameLength, email, emailLength);
+
+    w->len += VAL_INSERT_BASE_LENGTH + nameLength + emailLength;
+    w->records += 1;
+}
+
+/**
+ * Buffers a remove record
+ *
+ * @param w
+ * @param ssn
+ */
+void wal_append_remove(wal *w, const char *ssn) {
+    wal_reserve(w, VAL_REMOVE_BASE_LENGTH);
+
+    w->buffer[w->len] = VAL_REMOVE;
+    memcpy(w->buffer + w->len + 1, ssn, SSN_LENGTH);
+
+    w->len += VAL_REMOVE_BASE_LENGTH;
+    w->records += 1;
+}
+
+/**
+ * Writes every buffered record with a single write and syncs the log, so a whole batch of mutations costs
+ * one fdatasync
+ *
+ * @param w
+ * @return a status, -1 means the records could not be made durable and 0 means success
+ */
+int wal_commit(wal *w) {
+    size_t written = 0;
+
+    if(w->len == 0) {
+        return 0;
+    }
+
+    while(written < w->len) {
+        ssize_t result = write(w->fd, w->buffer + written, w->len - written);
+
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            perror("wal_commit || write");
+            return -1;
+        }
+        written += result;
+    }
+
+    w->len = 0;
+
+    if(fdatasync(w->fd) != 0) {
+        perror("wal_commit || fdatasync");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Empties the log, called once the table has been saved with every logged mutation
+ *
+ * @param w
+ * @return a status, -1 means the log could not be truncated and 0 means success
+ */
+int wal_truncate(wal *w) {
+    w->len = 0;
+    w->records = 0;
+
+    if(ftruncate(w->fd, 0) != 0) {
+        perror("wal_truncate || ftruncate");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Replays a log into a table covering every hash. The log is split per bucket and the buckets are replayed
+ * by up to WAL_MAX_THREADS threads, records of one bucket are applied in the order they were logged.
+ * A torn record at the end of the log is ignored
+ *
+ * @param path
+ * @param table
+ * @return the number of replayed records or -1 if the log could not be read
+ */
+long wal_replay(const char *path, hash_table *table) {
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    struct stat st;
+
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if(st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    const uint8_t *log = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(log == MAP_FAILED) {
+        perror("wal_replay || mmap");
+        return -1;
+    }
+
+    int span = hash_table_get_bucket_count(table);
+    long *starts = calloc(span + 1, sizeof(*starts));
+    long records = 0;
+    long offset = 0;
+    long length;
+    long total = 0;
+    long capacity = 1024;
+    char **ssns = malloc(capacity * sizeof(*ssns));
+
+    //Find every record, their ssns are hashed in one batch
+    while((length = wal_record_length(log, offset, st.st_size)) > 0) {
+        if(total == capacity) {
+            capacity *= 2;
+            ssns = realloc(ssns, capacity * sizeof(*ssns));
+
+            if(!ssns) {
+                perror("ssns || realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        ssns[total] = (char*)log + offset + 1;
+        total += 1;
+        offset += length;
+    }
+
+    if(offset < st.st_size) {
+        fprintf(stderr, "wal_replay: ignoring %ld bytes at the end of %s\n", (long)st.st_size - offset, path);
+    }
+
+    hash_t *hashes = malloc((total + 1) * sizeof(*hashes));
+    hash_ssn_batch(ssns, (int)total, hashes);
+
+    //Count the records of every bucket
+    for(long i = 0; i < total; i++) {
+        if(hashes[i] >= table->minHash && hashes[i] <= table->maxHash) {
+            starts[hash_table_bucket_index(table, hashes[i]) + 1] += 1;
+            records += 1;
+        }
+    }
+
+    for(int i = 0; i < span; i++) {
+        starts[i + 1] += starts[i];
+    }
+
+    //Place the offsets of the records bucket by bucket
+    long *offsets = malloc((records + 1) * sizeof(*offsets));
+    long *next = malloc(span * sizeof(*next));
+    memcpy(next, starts, span * sizeof(*next));
+
+    for(long i = 0; i < total; i++) {
+        if(hashes[i] >= table->minHash && hashes[i] <= table->maxHash) {
+            offsets[next[hash_table_bucket_index(table, hashes[i])]++] = ssns[i] - 1 - (char*)log;
+        }
+    }
+
+    free(ssns);
+    free(hashes);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus < 1 ? 1 : cpus > WAL_MAX_THREADS ? WAL_MAX_THREADS : (int)cpus;
+    pthread_t ids[WAL_MAX_THREADS];
+    wal_replay_job jobs[WAL_MAX_THREADS];
+
+    for(int i = 0; i < threads; i++) {
+        jobs[i] = (wal_replay_job){log, offsets, starts, table, i, threads};
+
+        if(i > 0 && pthread_create(&ids[i], NULL, wal_replay_buckets, &jobs[i]) != 0) {
+            perror("wal_replay || pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    wal_replay_buckets(&jobs[0]);
+
+    for(int i = 1; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    table->changes += records;
+
+    free(next);
+    free(offsets);
+    free(starts);
+    munmap((void*)log, st.st_size);
+
+    return records;
+}
+
+/**
+ * Applies the logged records of the buckets belonging to a replay thread
+ *
+ * @param arg the wal_replay_job
+ * @return NULL
+ */
+static void *wal_replay_buckets(void *arg) {
+    wal_replay_job *job = arg;
+    int span = hash_table_get_bucket_count(job->table);
+
+    for(int i = job->id; i < span; i += job->threads) {
+        bucket *b = &job->table->buckets[i];
+
+        for(long j = job->starts[i]; j < job->starts[i + 1]; j++) {
+            const char *pdu = (const char*)job->log + job->offsets[j];
+
+            if(pdu[0] == VAL_INSERT) {
+                uint8_t nameLength = pdu[1 + SSN_LENGTH];
+                uint8_t emailLength = pdu[2 + SSN_LENGTH + nameLength];
+
+                hash_table_bucket_insert(b, pdu + 1, pdu + 2 + SSN_LENGTH, nameLength, pdu + 3 + SSN_LENGTH + nameLength, emailLength);
+            } else {
+                hash_table_bucket_remove(b, pdu + 1);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns the length of the record at offset
+ *
+ * @param log
+ * @param offset
+ * @param size
+ * @return the length or 0 if there is no complete record at offset
+ */
+static long wal_record_length(const uint8_t *log, long offset, long size) {
+    long left = size - offset;
+
+    if(left >= VAL_REMOVE_BASE_LENGTH && log[offset] == VAL_REMOVE) {
+        return VAL_REMOVE_BASE_LENGTH;
+    }
+
+    if(left < VAL_INSERT_BASE_LENGTH || log[offset] != VAL_INSERT) {
+        return 0;
+    }
+
+    long length = VAL_INSERT_BASE_LENGTH + log[offset + 1 + SSN_LENGTH];
+
+    if(left < length) {
+        return 0;
+    }
+
+    length += log[offset + length - 1];
+
+    return left < length ? 0 : length;
+}
+
+/**
+ * Makes room for len more bytes in the buffer
+ *
+ * @param w
+ * @param len
+ */
+static void wal_reserve(wal *w, size_t len) {
+    if(w->len + len <= w->capacity) {
+        return;
+    }
+
+    w->capacity = w->capacity == 0 ? 4096 : w->capacity;
+
+    while(w->len + len > w->capacity) {
+        w->capacity *= 2;
+    }
+
+    w->buffer = realloc(w->buffer, w->capacity);
+
+    if(!w->buffer) {
+        perror("wal->buffer || realloc");
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,36 @@
+/**
+ * wal.h
+ *
+ * This file represents the interface for the write-ahead log of table mutations
+ *
+ */
+
+#ifndef OU3_WAL_H
+#define OU3_WAL_H
+
+#include <stddef.h>
+#include "hash_table.h"
+
+#define WAL_MAX_THREADS 8
+
+/**
+ * A data structure representing the write-ahead log. Appended records are buffered until wal_commit
+ * writes and syncs all of them at once
+ */
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t len;
+    size_t capacity;
+    unsigned long records;
+} wal;
+
+wal *wal_open(const char *path);
+void wal_close(wal *w);
+void wal_append_insert(wal *w, const char *ssn, const char *name, uint8_t nameLength, const char *email, uint8_t emailLength);
+void wal_append_remove(wal *w, const char *ssn);
+int wal_commit(wal *w);
+int wal_truncate(wal *w);
+long wal_replay(const char *path, hash_table *table);
+
+#endif //OU3_WAL_H
@@ -0,0 +1,261 @@
+/**
+ * workers.c
+ *
+ * This file represents the UDP worker threads. Every worker binds its own socket to the UDP port of the node
+ * with SO_REUSEPORT and a small BPF program on the port spreads the datagrams over the workers. Lookups
+ * are answered by the worker from the shared table without taking a lock, see HASH_CONCURRENT. Everything
+ * else, and lookups outside the range of the node, is handed to the state machine which is still the only
+ * thread that changes the table or talks to the ring
+ *
+ */
+
+#include "workers.h"
+#include "node_states.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/filter.h>
+#include "epoch.h"
+
+#if UDP_WORKERS > 0
+static void *worker_run(void *arg);
+static int worker_lookup(udp_worker *worker, const char *bytes, int len);
+static void steer_to_workers(int fd, int count);
+#endif
+
+/**
+ * Lets the UDP socket of the node share its port with the workers, has to be called before the socket is bound
+ *
+ * @param fd
+ */
+void workers_prepare_socket(int fd) {
+    int enable = 1;
+
+    if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+        perror("setsockopt || SO_REUSEPORT");
+        exit(EXIT_FAILURE);
+    }
+}
+
+#if UDP_WORKERS > 0
+/**
+ * Starts count workers on the port of udpFd. The workers read the table through the table pointer so
+ * the state machine can replace it, a table that is replaced has to outlive epoch_synchronize
+ *
+ * @param udpFd a bound socket prepared with workers_prepare_socket
+ * @param table
+ * @param count
+ * @return the workers
+ */
+udp_workers *workers_start(int udpFd, hash_table **table, int count) {
+    udp_workers *workers = calloc(1, sizeof(*workers));
+    workers->threads = calloc(count, sizeof(*workers->threads));
+
+    if(!workers->threads) {
+        perror("workers->threads || calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    workers->count = count;
+    workers->table = table;
+
+    int pair[2];
+
+    if(socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) == -1) {
+        perror("socketpair");
+        exit(EXIT_FAILURE);
+    }
+
+    workers->handoff = (struct pollfd){pair[0], POLLIN};
+    workers->handoffFd = pair[1];
+
+    struct sockaddr_in addr = {};
+    socklen_t addrLength = sizeof(addr);
+
+    if(getsockname(udpFd, (struct sockaddr*)&addr, &addrLength) == -1) {
+        perror("getsockname");
+        exit(EXIT_FAILURE);
+    }
+
+    for(int i = 0; i < count; i++) {
+        udp_worker *worker = &workers->threads[i];
+        worker->workers = workers;
+        worker->fd = create_socket(SOCK_DGRAM);
+        workers_prepare_socket(worker->fd);
+
+        if(bind(worker->fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            perror("bind || worker");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    steer_to_workers(udpFd, count);
+
+    for(int i = 0; i < count; i++) {
+        if(pthread_create(&workers->threads[i].thread, NULL, worker_run, &workers->threads[i]) != 0) {
+            perror("workers_start || pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("    Started %d UDP workers on port %d\n", count, ntohs(addr.sin_port));
+
+    return workers;
+}
+
+/**
+ * Stops and joins the workers and closes their sockets
+ *
+ * @param workers
+ */
+void workers_stop(udp_workers *workers) {
+    __atomic_store_n(&workers->stop, 1, __ATOMIC_RELEASE);
+
+    for(int i = 0; i < workers->count; i++) {
+        udp_worker *worker = &workers->threads[i];
+
+        pthread_join(worker->thread, NULL);
+        close(worker->fd);
+
+        printf("    Worker %d served %lu lookups and handed off %lu datagrams\n", i, worker->served, worker->handedOff);
+    }
+
+    close(workers->handoff.fd);
+    close(workers->handoffFd);
+    free(workers->threads);
+    free(workers);
+}
+
+/**
+ * The loop of a worker thread
+ *
+ * @param arg the worker
+ * @return NULL
+ */
+static void *worker_run(void *arg) {
+    udp_worker *worker = arg;
+    udp_workers *workers = worker->workers;
+
+    //SIGINT is for the state machine which hands the range off before exiting
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct pollfd fd = {worker->fd, POLLIN};
+    char bytes[BUFF_SIZE];
+
+    while(!__atomic_load_n(&workers->stop, __ATOMIC_ACQUIRE)) {
+        if(poll(&fd, 1, WORKER_POLL_TIMEOUT) < 0 && errno != EINTR) {
+            perror("poll || worker");
+            exit(EXIT_FAILURE);
+        }
+
+        while(1) {
+            int len = (int)recv(worker->fd, bytes, sizeof(bytes), MSG_DONTWAIT);
+
+            if(len < 0) {
+                if(errno == EWOULDBLOCK || errno == EINTR) {
+                    break;
+                }
+                perror("recv || worker");
+                exit(EXIT_FAILURE);
+            }
+
+            if(worker_lookup(worker, bytes, len)) {
+                worker->served += 1;
+                continue;
+            }
+
+            if(send(workers->handoffFd, bytes, len, 0) == -1) {
+                perror("send || handoff");
+                exit(EXIT_FAILURE);
+            }
+            worker->handedOff += 1;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Answers a datagram that holds a single VAL_LOOKUP for an ssn in the range of the node
+ *
+ * @param worker
+ * @param bytes
+ * @param len
+ * @return 1 if the lookup was answered, 0 if the datagram has to go to the state machine
+ */
+static int worker_lookup(udp_worker *worker, const char *bytes, int len) {
+    static __thread int reader = -1;
+
+    if(len != VAL_LOOKUP_BASE_LENGTH || parse_pdu_type(bytes) != VAL_LOOKUP) {
+        return 0;
+    }
+
+    if(reader < 0) {
+        reader = epoch_register();
+    }
+
+    struct VAL_LOOKUP_PDU pdu;
+    parse_val_lookup_pdu(VAL_LOOKUP, bytes, &pdu);
+
+    hash_table_entry entry = {};
+    uint8_t record[HASH_TABLE_RECORD_MAX];
+
+    epoch_enter(reader);
+    hash_table *table = __atomic_load_n(worker->workers->table, __ATOMIC_ACQUIRE);
+    int status = table ? hash_table_lookup_concurrent(table, (char*)pdu.ssn, &entry, record) : -1;
+    epoch_exit(reader);
+
+    if(status < 0) {
+        return 0;
+    }
+
+    char header[VAL_LOOKUP_RESPONSE_HEADER_LENGTH];
+    struct iovec iov[2];
+
+    serialize_val_lookup_response_iov(header, iov, &entry);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = pdu.sender_address;
+    addr.sin_port = pdu.sender_port;
+
+    struct msghdr message = {};
+    message.msg_name = &addr;
+    message.msg_namelen = sizeof(addr);
+    message.msg_iov = iov;
+    message.msg_iovlen = 2;
+
+    sendmsg(worker->fd, &message, 0);
+
+    return 1;
+}
+
+/**
+ * Attaches a BPF program to the port that sends every datagram to a random worker. The socket of the
+ * state machine was bound first so it is number 0 in the port group and the workers are 1 to count
+ *
+ * @param fd any socket bound to the port
+ * @param count
+ */
+static void steer_to_workers(int fd, int count) {
+    struct sock_filter code[] = {
+            {BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_RANDOM)},
+            {BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)count},
+            {BPF_ALU | BPF_ADD | BPF_K, 0, 0, 1},
+            {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog program = {sizeof(code) / sizeof(code[0]), code};
+
+    if(setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == -1) {
+        //The kernel spreads the datagrams by address instead, the state machine keeps reading its own socket
+        perror("setsockopt || SO_ATTACH_REUSEPORT_CBPF");
+    }
+}
+#endif
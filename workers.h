@@ -0,0 +1,54 @@
+/**
+ * workers.h
+ *
+ * This file represents the interface for the UDP worker threads that answer lookups next to the state machine
+ *
+ */
+
+#ifndef OU3_WORKERS_H
+#define OU3_WORKERS_H
+
+#include <poll.h>
+#include <pthread.h>
+#include "hash_table.h"
+
+//The number of threads that share the UDP port of the node, 0 leaves all traffic to the state machine
+#ifndef UDP_WORKERS
+#define UDP_WORKERS 0
+#endif
+
+#if UDP_WORKERS > 0 && !HASH_CONCURRENT
+#error "UDP_WORKERS needs HASH_CONCURRENT"
+#endif
+
+#define WORKER_POLL_TIMEOUT 100
+
+/**
+ * A worker thread and the socket it reads from, the socket is bound to the UDP port of the node
+ */
+typedef struct {
+    pthread_t thread;
+    int fd;
+    unsigned long served;
+    unsigned long handedOff;
+    struct udp_workers *workers;
+} udp_worker;
+
+/**
+ * The UDP workers of a node. Every worker answers VAL_LOOKUP from the shared table and hands every other
+ * datagram to the state machine, which reads them from the handoff socket instead of its UDP socket
+ */
+typedef struct udp_workers {
+    udp_worker *threads;
+    int count;
+    int stop;
+    int handoffFd;
+    struct pollfd handoff;
+    hash_table **table;
+} udp_workers;
+
+void workers_prepare_socket(int fd);
+udp_workers *workers_start(int udpFd, hash_table **table, int count);
+void workers_stop(udp_workers *workers);
+
+#endif //OU3_WORKERS_H